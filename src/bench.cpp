@@ -2,19 +2,44 @@
 #include <filesystem>
 #include <format>
 #include <fstream>
+#include <optional>
 #include <random>
 #include <string>
 #include <thread>
 #include <vector>
+#include <cstdio>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 #include "bench.h"
 #include "misc.h"
+#include "perf.h"
 #include "search.h"
+#include "stats.h"
 #include "string.h"
 #include "timer.h"
 #include "tt.h"
 #include "uci.h"
 using namespace std;
 
+struct BenchResult {
+    string fen;
+    string best_move;
+
+    int depth       = 0;
+    int sel_depth   = 0;
+
+    i64 nodes       = 0;
+    i64 time_ns     = 0;
+    i64 nps         = 0;
+
+    size_t tt_hitrate = 0;
+};
+
 struct Bench {
     std::size_t num     = 30;
     std::size_t time    =  0;
@@ -22,22 +47,34 @@ struct Bench {
     std::size_t nodes   =  0;
     std::size_t hash    =  8;
 
+    // Worker processes, and the share of the positions searched by one
+    std::size_t concurrency = 0;
+    std::size_t part        = 0;
+    std::size_t parts       = 0;
+
     bool exc_mated  = true;
     bool rand       = false;
     bool barenodes  = false;
     bool baretime   = false;
+    bool counters   = false;
 
     std::map<std::string, std::string> opts;
 
     std::filesystem::path path { "bench.epd" };
+    std::filesystem::path json;
+    std::filesystem::path compare;
 
     std::vector<Position> positions;
+    std::vector<BenchResult> results;
 };
 
-static void benchmark_input (Bench& bench);
-static void benchmark_go    (Bench& bench);
+static void benchmark_input   (Bench& bench);
+static void benchmark_go      (Bench& bench);
+static int  benchmark_spawn   (const Bench& bench, const vector<string>& args);
+static void benchmark_json    (const Bench& bench);
+static bool benchmark_compare (const Bench& bench);
 
-void benchmark(int argc, char* argv[])
+int benchmark(int argc, char* argv[])
 {
     Tokenizer fields(argc, argv);
 
@@ -53,6 +90,16 @@ void benchmark(int argc, char* argv[])
             bench.barenodes = true;
         else if (k == "baretime")
             bench.baretime = true;
+        else if (k == "compare") {
+            filesystem::path p { v };
+            bench.compare = p;
+        }
+        else if (k == "concurrency") {
+            size_t n = stoull(v);
+            bench.concurrency = clamp<size_t>(n, 1, 256);
+        }
+        else if (k == "counters")
+            bench.counters = true;
         else if (k == "depth") {
             size_t n = stoull(v);
             bench.depth = n;
@@ -65,6 +112,10 @@ void benchmark(int argc, char* argv[])
             size_t n = stoull(v);
             bench.hash = n;
         }
+        else if (k == "json") {
+            filesystem::path p { v.empty() ? "bench.json" : v };
+            bench.json = p;
+        }
         else if (k == "mates")
             bench.exc_mated = false;
         else if (k == "nodes") {
@@ -77,6 +128,11 @@ void benchmark(int argc, char* argv[])
         }
         else if (k.starts_with("option."))
             bench.opts[k.substr(7)] = v;
+        else if (k == "part") {
+            Tokenizer part(v, '/');
+            bench.part  = stoull(part.get(0));
+            bench.parts = stoull(part.get(1, "1"));
+        }
         else if (k == "random")
             bench.rand = true;
         else if (k == "time") {
@@ -85,12 +141,45 @@ void benchmark(int argc, char* argv[])
         }
         else {
             cerr << "Unknown option: " << k << endl;
-            return;
+            return EXIT_FAILURE;
         }
     }
 
     benchmark_input(bench);
+
+    if (bench.concurrency) {
+        vector<string> args;
+
+        for (size_t i = 0; i < fields.size(); i++) {
+            string k = Tokenizer(fields[i], '=').get(0);
+
+            if (k != "concurrency" && k != "json" && k != "compare" && k != "barenodes" && k != "baretime")
+                args.push_back(fields[i]);
+        }
+
+        return benchmark_spawn(bench, args);
+    }
+
+    // A worker searches every parts-th of the first num positions
+    if (bench.parts) {
+        vector<Position> positions;
+
+        for (size_t i = bench.part; i < min(bench.num, bench.positions.size()); i += bench.parts)
+            positions.push_back(bench.positions[i]);
+
+        bench.positions = positions;
+        bench.num = -1;
+    }
+
     benchmark_go(bench);
+
+    if (!bench.json.empty())
+        benchmark_json(bench);
+
+    if (!bench.compare.empty() && !benchmark_compare(bench))
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
 }
 
 void benchmark_go(Bench &bench)
@@ -105,6 +194,15 @@ void benchmark_go(Bench &bench)
     ttable = TT(bench.hash);
     ttable.init();
 
+    PerfCounters counters;
+
+    if (bench.counters)
+        counters.open();
+
+#ifdef SEARCH_STATS
+    SearchStats stats;
+#endif
+
     for (auto kv : bench.opts) {
         string s = "setoption name " + kv.first + " value " + kv.second;
         uci_setoption(s);
@@ -114,7 +212,7 @@ void benchmark_go(Bench &bench)
 
     gstats.exc_mated = bench.exc_mated;
 
-    bool quiet = bench.barenodes || bench.baretime;
+    bool quiet = bench.barenodes || bench.baretime || bench.parts;
 
     for (const auto& pos : bench.positions) {
 
@@ -141,7 +239,31 @@ void benchmark_go(Bench &bench)
         si.reset();
         si.timer.start();
 
+        int normal = gstats.normal;
+
+        counters.start();
         search_start();
+        counters.stop();
+
+#ifdef SEARCH_STATS
+        stats += sstats;
+#endif
+
+        // Mated and stalemated positions are not searched
+        if (gstats.normal != normal) {
+            BenchResult r;
+
+            r.fen        = pos.to_fen();
+            r.best_move  = si.best_move.str();
+            r.depth      = si.max_depth;
+            r.sel_depth  = si.sel_depth;
+            r.nodes      = si.tnodes;
+            r.time_ns    = timer.elapsed_time<Timer::Nano>();
+            r.nps        = r.time_ns > 0 ? i64(r.nodes / (r.time_ns / 1e+9)) : 0;
+            r.tt_hitrate = ttable.hitrate();
+
+            bench.results.push_back(r);
+        }
         
         if (gstats.num == bench.num) break;
     }
@@ -156,6 +278,10 @@ void benchmark_go(Bench &bench)
     vector<string> units_time { "ns", "us", "ms", "s " };
     vector<string> units_speed { "nps ", "knps", "mnps" };
     
+    if (bench.parts) {
+        cerr << tnodes << ' ' << ttime_ns << ' ' << num << endl;
+        return;
+    }
     if (bench.barenodes) {
         cerr << tnodes << endl;
         return;
@@ -199,6 +325,18 @@ void benchmark_go(Bench &bench)
          << format("nodes        = {:13}", tnodes) << endl
          << format("nps          = {:13}", int(tnodes / ttime_s)) << endl
          << format("time         = {:>16}", Timer::to_string(ttime_ns, { "ns", "us", "ms" })) << endl;
+
+    if (bench.counters) {
+        cerr << endl;
+        counters.print(cerr, tnodes, "node");
+    }
+
+#ifdef SEARCH_STATS
+    cerr << endl;
+
+    for (const string& line : stats.lines())
+        cerr << line << endl;
+#endif
 }
 
 void benchmark_input(Bench& bench)
@@ -213,3 +351,304 @@ void benchmark_input(Bench& bench)
         bench.positions.emplace_back(fields[0]);
     }
 }
+
+struct BenchPart {
+    i64 nodes       = 0;
+    i64 time_ns     = 0;
+    i64 positions   = 0;
+};
+
+// Runs count copies of this executable, each over its part of the positions
+// with its own hash table, and collects their totals
+static bool benchmark_parts(const vector<string>& args, size_t count, vector<BenchPart>& parts)
+{
+    parts.assign(count, BenchPart());
+
+#if defined(__linux__)
+    vector<pid_t> pids;
+    vector<int> fds;
+
+    for (size_t w = 0; w < count; w++) {
+        vector<string> wargs { "cadie", "bench" };
+
+        wargs.insert(wargs.end(), args.begin(), args.end());
+        wargs.push_back(format("part={}/{}", w, count));
+
+        vector<char *> argv;
+
+        for (string& a : wargs)
+            argv.push_back(a.data());
+
+        argv.push_back(nullptr);
+
+        int fd[2];
+
+        if (pipe2(fd, O_CLOEXEC) < 0)
+            break;
+
+        pid_t pid = fork();
+
+        if (pid < 0) {
+            close(fd[0]);
+            close(fd[1]);
+            break;
+        }
+
+        if (pid == 0) {
+            int null = open("/dev/null", O_WRONLY);
+
+            dup2(null, STDOUT_FILENO);
+            dup2(fd[1], STDERR_FILENO);
+
+            execv("/proc/self/exe", argv.data());
+            _exit(EXIT_FAILURE);
+        }
+
+        close(fd[1]);
+
+        pids.push_back(pid);
+        fds.push_back(fd[0]);
+    }
+
+    bool ok = pids.size() == count;
+
+    for (size_t w = 0; w < pids.size(); w++) {
+        string out;
+        char buf[256];
+
+        for (ssize_t n; (n = read(fds[w], buf, sizeof(buf))) > 0; )
+            out.append(buf, n);
+
+        close(fds[w]);
+        waitpid(pids[w], nullptr, 0);
+
+        Tokenizer fields(out, ' ');
+
+        if (fields.size() < 3) {
+            ok = false;
+            continue;
+        }
+
+        parts[w].nodes      = stoll(fields[0]);
+        parts[w].time_ns    = stoll(fields[1]);
+        parts[w].positions  = stoll(fields[2]);
+    }
+
+    return ok;
+#else
+    (void)args;
+
+    return false;
+#endif
+}
+
+// Searches run concurrently, so the aggregate speed is the sum of nodes
+// over the time of the slowest worker
+static i64 benchmark_aggregate(const vector<BenchPart>& parts)
+{
+    i64 nodes   = 0;
+    i64 time_ns = 0;
+
+    for (const auto& p : parts) {
+        nodes  += p.nodes;
+        time_ns = max(time_ns, p.time_ns);
+    }
+
+    return time_ns > 0 ? i64(nodes / (time_ns / 1e+9)) : 0;
+}
+
+int benchmark_spawn(const Bench& bench, const vector<string>& args)
+{
+    vector<BenchPart> single;
+    vector<BenchPart> parts;
+
+    if (   !benchmark_parts(args, 1, single)
+        || !benchmark_parts(args, bench.concurrency, parts)) {
+        cerr << "Could not run bench workers" << endl;
+        return EXIT_FAILURE;
+    }
+
+    vector<string> units_speed { "nps ", "knps", "mnps" };
+
+    cerr << endl << "Workers" << endl;
+
+    for (size_t w = 0; w < parts.size(); w++) {
+        const BenchPart& p = parts[w];
+
+        i64 nps = p.time_ns > 0 ? i64(p.nodes / (p.time_ns / 1e+9)) : 0;
+
+        cerr << format(" {:3}  positions = {:4}  nodes = {:13}  nps = {:>18}",
+                       w + 1, p.positions, p.nodes, Timer::to_string(nps, units_speed)) << endl;
+    }
+
+    i64 nps1 = benchmark_aggregate(single);
+    i64 npsn = benchmark_aggregate(parts);
+
+    double efficiency = nps1 > 0 ? double(npsn) / (nps1 * bench.concurrency) : 0.0;
+
+    cerr << endl
+         << "Overall" << endl
+         << format(" nps 1       = {:>18}", Timer::to_string(nps1, units_speed)) << endl
+         << format(" nps {:<7} = {:>18}", bench.concurrency, Timer::to_string(npsn, units_speed)) << endl
+         << format(" speedup     = {:13.2f}", nps1 > 0 ? double(npsn) / nps1 : 0.0) << endl
+         << format(" efficiency  = {:13.2f}", efficiency) << endl;
+
+    return EXIT_SUCCESS;
+}
+
+// One position per line, so that compare can read the file back without a
+// JSON parser. The signature is the total node count; it only depends on
+// the limits and the hash size, unless a time limit is set.
+
+void benchmark_json(const Bench& bench)
+{
+    ofstream ofs(bench.json);
+
+    if (!ofs) {
+        cerr << "Cannot write " << bench.json.string() << endl;
+        return;
+    }
+
+    i64 tnodes  = 0;
+    i64 ttime   = 0;
+
+    for (const auto& r : bench.results) {
+        tnodes += r.nodes;
+        ttime  += r.time_ns;
+    }
+
+    ofs << "{" << endl
+        << format("  \"engine\": \"Cadie {}\",", CADIE_VERSION) << endl
+        << format("  \"depth\": {},", bench.depth) << endl
+        << format("  \"nodes\": {},", bench.nodes) << endl
+        << format("  \"time\": {},", bench.time) << endl
+        << format("  \"hash\": {},", bench.hash) << endl
+        << "  \"positions\": [" << endl;
+
+    for (size_t i = 0; i < bench.results.size(); i++) {
+        const BenchResult& r = bench.results[i];
+
+        ofs << format("    {{ \"fen\": \"{}\", \"depth\": {}, \"seldepth\": {}, \"nodes\": {}, "
+                      "\"time_ns\": {}, \"nps\": {}, \"bestmove\": \"{}\", \"tt_hitrate\": {} }}{}",
+                      r.fen, r.depth, r.sel_depth, r.nodes, r.time_ns, r.nps, r.best_move, r.tt_hitrate,
+                      i + 1 < bench.results.size() ? "," : "") << endl;
+    }
+
+    ofs << "  ]," << endl
+        << format("  \"total\": {{ \"positions\": {}, \"nodes\": {}, \"time_ns\": {}, \"nps\": {} }},",
+                  bench.results.size(), tnodes, ttime, ttime > 0 ? i64(tnodes / (ttime / 1e+9)) : 0) << endl
+        << format("  \"signature\": {}", tnodes) << endl
+        << "}" << endl;
+}
+
+// Returns the value of "key" in a line written by benchmark_json
+static optional<string> json_value(const string& line, const string& key)
+{
+    string k = "\"" + key + "\": ";
+
+    size_t i = line.find(k);
+
+    if (i == string::npos)
+        return nullopt;
+
+    i += k.size();
+
+    if (line[i] == '"') {
+        size_t j = line.find('"', i + 1);
+        return line.substr(i + 1, j - i - 1);
+    }
+
+    size_t j = line.find_first_of(",}", i);
+
+    return line.substr(i, j == string::npos ? string::npos : j - i);
+}
+
+// Node counts only change with the search itself, nps only with its speed.
+// Returns false if any node count differs from the previous run.
+
+bool benchmark_compare(const Bench& bench)
+{
+    ifstream ifs(bench.compare);
+
+    if (!ifs) {
+        cerr << "Cannot read " << bench.compare.string() << endl;
+        return false;
+    }
+
+    vector<BenchResult> prev;
+
+    i64 prev_sig = -1;
+    i64 prev_nps = 0;
+
+    string limits;
+
+    for (string line; getline(ifs, line); ) {
+        if (auto fen = json_value(line, "fen")) {
+            BenchResult r;
+
+            r.fen   = *fen;
+            r.nodes = stoll(json_value(line, "nodes").value_or("0"));
+            r.nps   = stoll(json_value(line, "nps").value_or("0"));
+
+            prev.push_back(r);
+        }
+        else if (line.find("\"total\"") != string::npos)
+            prev_nps = stoll(json_value(line, "nps").value_or("0"));
+        else if (auto v = json_value(line, "signature"))
+            prev_sig = stoll(*v);
+        else {
+            for (string key : { "depth", "nodes", "time", "hash" })
+                if (auto value = json_value(line, key))
+                    limits += key + "=" + *value + " ";
+        }
+    }
+
+    string curr_limits = format("depth={} nodes={} time={} hash={} ", bench.depth, bench.nodes, bench.time, bench.hash);
+
+    i64 tnodes  = 0;
+    i64 ttime   = 0;
+
+    for (const auto& r : bench.results) {
+        tnodes += r.nodes;
+        ttime  += r.time_ns;
+    }
+
+    i64 nps = ttime > 0 ? i64(tnodes / (ttime / 1e+9)) : 0;
+
+    cerr << endl << "Compare with " << bench.compare.string() << endl;
+
+    if (limits != curr_limits)
+        cerr << " limits differ: " << limits << "vs " << curr_limits << endl;
+
+    if (bench.time)
+        cerr << " time limit set, node counts are not deterministic" << endl;
+
+    size_t changed = 0;
+
+    for (size_t i = 0; i < min(prev.size(), bench.results.size()); i++) {
+        const BenchResult& p = prev[i];
+        const BenchResult& r = bench.results[i];
+
+        if (p.fen != r.fen) {
+            cerr << format(" position {:4} differs: {}", i + 1, r.fen) << endl;
+            changed++;
+        }
+        else if (p.nodes != r.nodes) {
+            cerr << format(" position {:4} nodes {} -> {}", i + 1, p.nodes, r.nodes) << endl;
+            changed++;
+        }
+    }
+
+    if (prev.size() != bench.results.size()) {
+        cerr << format(" positions {} -> {}", prev.size(), bench.results.size()) << endl;
+        changed++;
+    }
+
+    double speed = prev_nps > 0 ? 100.0 * (nps - prev_nps) / prev_nps : 0.0;
+
+    cerr << format(" signature   = {:13} -> {:13}  {}", prev_sig, tnodes,
+                   changed || prev_sig != tnodes ? "functional change" : "unchanged") << endl
+         << format(" nps         = {:13} -> {:13}  {:+.1f}%", prev_nps, nps, speed) << endl;
+
+    return !changed && prev_sig == tnodes;
+}
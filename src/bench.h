@@ -8,6 +8,6 @@
 #include <cstdlib>
 #include "pos.h"
 
-void benchmark(int argc, char* argv[]);
+int benchmark(int argc, char* argv[]);
 
 #endif
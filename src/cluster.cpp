@@ -0,0 +1,654 @@
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cinttypes>
+#include <cstdio>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "cluster.h"
+#include "pos.h"
+#include "search.h"
+#include "string.h"
+#include "timer.h"
+#include "tt.h"
+#include "uci.h"
+using namespace std;
+
+bool ClusterShare       = false;
+int  ClusterShareDepth  =    10;
+
+// A worker process, connected through a Unix domain socket that is its
+// stdin and stdout. Workers speak UCI plus the tt command, and report each
+// completed iteration with an iteration line.
+
+struct ClusterResult {
+    int score = 0;
+    vector<string> pv;
+};
+
+struct ClusterWorker {
+    int pid = -1;
+    int fd  = -1;
+
+    string inbuf;
+
+    // Has root moves in the current search, and has sent bestmove
+    bool active = false;
+    bool done   = false;
+
+    // Result of each completed iteration
+    vector<ClusterResult> results;
+
+    int depth       = 0;
+    int sel_depth   = 0;
+    i64 nodes       = 0;
+};
+
+static vector<ClusterWorker> workers;
+
+// Set in worker processes
+static bool WorkerMode = false;
+
+// Entries received by the UCI thread, stored by the search thread
+struct ClusterEntry {
+    u64 key;
+    Move move;
+    int score;
+    int eval;
+    int depth;
+    u8 bound;
+};
+
+static mutex entry_mutex;
+static vector<ClusterEntry> entry_queue;
+static atomic_bool entry_pending = false;
+
+static bool cluster_spawn(int count);
+static void cluster_stop();
+static void cluster_send(ClusterWorker& w, const string& s);
+static void cluster_info(ClusterWorker& w, const Tokenizer& fields);
+static void cluster_result(ClusterWorker& w, const Tokenizer& fields);
+static void cluster_report(int depth);
+static void cluster_test(const vector<Position>& positions, size_t time, size_t hash, int count);
+
+template <class F>
+static void cluster_poll(int timeout, F handle);
+
+void cluster(int argc, char* argv[])
+{
+    Tokenizer fields(argc, argv);
+
+    string mode = "uci";
+
+    int count   = clamp(int(thread::hardware_concurrency()) / 2, 2, 64);
+
+    size_t num  = 10;
+    size_t time = 1000;
+    size_t hash = 16;
+
+    string path = "bench.epd";
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        Tokenizer args(fields[i], '=');
+
+        string k = args.get(0);
+        string v = args.get(1, "");
+
+        if (k == "worker" || k == "test")
+            mode = k;
+        else if (k == "file")
+            path = v;
+        else if (k == "hash")
+            hash = stoull(v);
+        else if (k == "num")
+            num = stoull(v);
+        else if (k == "share")
+            ClusterShareDepth = stoi(v);
+        else if (k == "time")
+            time = stoull(v);
+        else if (k == "workers")
+            count = clamp(stoi(v), 1, 64);
+        else {
+            cerr << "Unknown option: " << k << endl;
+            return;
+        }
+    }
+
+    if (mode == "test") {
+        vector<Position> positions;
+
+        ifstream ifs(path);
+
+        for (string line; getline(ifs, line) && positions.size() < num; ) {
+            if (line.empty() || line[0] == '#') continue;
+
+            positions.emplace_back(Tokenizer(line, ',')[0]);
+        }
+
+        cluster_test(positions, time, hash, count);
+        return;
+    }
+
+    WorkerMode   = mode == "worker";
+    ClusterShare = WorkerMode;
+
+    if (mode == "uci" && !cluster_spawn(count)) {
+        cerr << "Could not start cluster workers" << endl;
+        cluster_stop();
+        return;
+    }
+
+    setvbuf(stdin, nullptr, _IONBF, 0);
+    setvbuf(stdout, nullptr, _IONBF, 0);
+
+    uci_loop();
+
+    cluster_stop();
+}
+
+bool cluster_active()
+{
+    return !workers.empty();
+}
+
+bool cluster_worker()
+{
+    return WorkerMode;
+}
+
+// Positions, new games and options are passed on as they are. Only the
+// UCI thread calls this, while no search is running.
+void cluster_forward(const string& line)
+{
+    for (ClusterWorker& w : workers)
+        cluster_send(w, line);
+}
+
+// Coordinator side of search_iterate: the root moves are dealt out to the
+// workers, which search them with go searchmoves. A depth is reported once
+// every worker has completed it, taking the best score among them.
+void cluster_iterate()
+{
+    size_t alive = count_if(workers.begin(), workers.end(), [](const ClusterWorker& w) { return w.fd >= 0; });
+    size_t n     = min(alive, si.rmoves.size());
+
+    vector<string> lists(n);
+
+    for (size_t i = 0; i < si.rmoves.size() && n; i++)
+        lists[i % n] += ' ' + si.rmoves[i].move.str();
+
+    string limits = sl.depth ? " depth " + to_string(sl.depth) : "";
+
+    for (size_t i = 0, j = 0; i < workers.size(); i++) {
+        ClusterWorker& w = workers[i];
+
+        w.active    = w.fd >= 0 && j < n;
+        w.done      = !w.active;
+        w.depth     = 0;
+        w.sel_depth = 0;
+        w.nodes     = 0;
+
+        w.results.clear();
+
+        if (w.active)
+            cluster_send(w, "go infinite" + limits + " searchmoves" + lists[j++]);
+    }
+
+    auto handle = [](ClusterWorker& w, const string& line) {
+        Tokenizer fields(line);
+
+        if (fields.size() == 0)
+            return;
+
+        // TT entries are relayed to the other workers of this search
+        if (fields[0] == "tt") {
+            for (ClusterWorker& o : workers)
+                if (&o != &w && o.active && !o.done)
+                    cluster_send(o, line);
+        }
+
+        else if (fields[0] == "bestmove")
+            w.done = true;
+
+        else if (fields[0] == "info")
+            cluster_info(w, fields);
+
+        else if (fields[0] == "iteration")
+            cluster_result(w, fields);
+    };
+
+    int reported = 0;
+
+    bool finish = n == 0;
+
+    while (!finish) {
+        cluster_poll(1, handle);
+
+        int depth = DepthMax;
+        int count = 0;
+
+        si.tnodes = 0;
+
+        for (const ClusterWorker& w : workers) {
+            if (!w.active)
+                continue;
+
+            si.tnodes    += w.nodes;
+            si.sel_depth  = max(si.sel_depth, w.sel_depth);
+
+            // A worker that went away no longer holds back the depth
+            if (w.fd >= 0) {
+                depth = min(depth, w.depth);
+                count++;
+            }
+        }
+
+        if (count == 0)
+            break;
+
+        while (!finish && reported < depth) {
+            cluster_report(++reported);
+
+            finish = search_iteration_done(reported) || reported >= DepthMax;
+        }
+
+        if (si.checkup())
+            finish = true;
+    }
+
+    for (ClusterWorker& w : workers)
+        if (w.active && !w.done)
+            cluster_send(w, "stop");
+
+    while (any_of(workers.begin(), workers.end(), [](const ClusterWorker& w) { return !w.done; }))
+        cluster_poll(10, handle);
+
+    si.tnodes = 0;
+
+    for (const ClusterWorker& w : workers)
+        si.tnodes += w.active ? w.nodes : 0;
+}
+
+// Worker side: sends an entry of the main search to the coordinator
+void cluster_offer(u64 key, Move m, int score, int eval, int depth, u8 bound)
+{
+    uci_send("tt %" PRIu64 " %s %d %d %d %d", key, m ? m.str().c_str() : "0000", score, eval, depth, bound);
+}
+
+// Worker side: queues an entry that another worker sent, in the form of
+// cluster_offer. Scores are already relative to the entry's position. Only
+// the UCI thread calls this; the search thread stores the entries.
+void cluster_receive(const string& line)
+{
+    Tokenizer fields(line);
+
+    if (fields.size() < 7)
+        return;
+
+    ClusterEntry e;
+
+    e.key   = stoull(fields[1]);
+    e.move  = fields[2] == "0000" ? Move::None() : Move::from_string(fields[2]);
+    e.score = stoi(fields[3]);
+    e.eval  = stoi(fields[4]);
+    e.depth = stoi(fields[5]);
+    e.bound = stoi(fields[6]);
+
+    lock_guard<mutex> lock(entry_mutex);
+
+    entry_queue.push_back(e);
+    entry_pending.store(true, memory_order_relaxed);
+}
+
+// Worker side: stores the queued entries, called by the search thread
+void cluster_apply()
+{
+    if (!entry_pending.load(memory_order_relaxed))
+        return;
+
+    vector<ClusterEntry> entries;
+
+    {
+        lock_guard<mutex> lock(entry_mutex);
+
+        entries.swap(entry_queue);
+        entry_pending.store(false, memory_order_relaxed);
+    }
+
+    for (const ClusterEntry& e : entries)
+        ttable.set(e.key, e.move, e.score, e.eval, e.depth, e.bound, 0);
+}
+
+// Worker side: reports a completed iteration with the internal score and
+// the line of the best root move
+void cluster_iteration(int depth)
+{
+    const RootMove& rm = si.rmoves[0];
+
+    string pv;
+
+    for (size_t i = 0; i < PliesMax && rm.pv[i] != Move::None(); i++)
+        pv += ' ' + rm.pv[i].str();
+
+    uci_send("iteration %d %d%s", depth, rm.score, pv.c_str());
+}
+
+// Progress of a worker. Results only come from its iteration lines, since
+// info lines are also sent for iterations that are not complete yet.
+static void cluster_info(ClusterWorker& w, const Tokenizer& fields)
+{
+    for (size_t i = 1; i + 1 < fields.size(); i++) {
+        const string& token = fields[i];
+
+        if (token == "string" || token == "pv")
+            return;
+        else if (token == "seldepth")
+            w.sel_depth = max(w.sel_depth, stoi(fields[++i]));
+        else if (token == "nodes")
+            w.nodes = stoll(fields[++i]);
+    }
+}
+
+static void cluster_result(ClusterWorker& w, const Tokenizer& fields)
+{
+    if (fields.size() < 4)
+        return;
+
+    int depth = stoi(fields[1]);
+
+    if (depth <= 0)
+        return;
+
+    if (w.results.size() <= size_t(depth))
+        w.results.resize(depth + 1);
+
+    w.results[depth] = { stoi(fields[2]), fields.subtok(3) };
+    w.depth = max(w.depth, depth);
+}
+
+static void cluster_report(int depth)
+{
+    const ClusterResult * best = nullptr;
+
+    for (const ClusterWorker& w : workers) {
+        if (!w.active || w.results.size() <= size_t(depth))
+            continue;
+
+        const ClusterResult& r = w.results[depth];
+
+        if (!r.pv.empty() && (!best || r.score > best->score))
+            best = &r;
+    }
+
+    if (!best)
+        return;
+
+    PV pv;
+
+    Position pos = si.pos;
+
+    vector<UndoInfo> undos;
+
+    for (const string& s : best->pv) {
+        if (undos.size() >= PliesMax - 1)
+            break;
+
+        Move m = pos.note_move(s);
+
+        pv[undos.size()] = m;
+
+        undos.push_back(pos.undo_info());
+
+        pos.make_move(m);
+    }
+
+    pv[undos.size()] = Move::None();
+
+    // Unwinds the key and move stacks
+    while (!undos.empty()) {
+        pos.unmake_move(undos.back());
+        undos.pop_back();
+    }
+
+    si.root_depth    = depth;
+    si.curr_move     = pv[0];
+    si.curr_move_num = 1;
+
+    si.update(depth, best->score, pv);
+}
+
+// Runs the positions once in this process and once on the cluster, each
+// for a fixed time, and compares the node throughput
+static void cluster_test(const vector<Position>& positions, size_t time, size_t hash, int count)
+{
+    auto run = [&]() {
+        Timer timer(true);
+
+        i64 nodes = 0;
+
+        for (const Position& pos : positions) {
+            search_reset();
+
+            mstack.clear();
+            mstack.add(Move::None());
+            mstack.add(Move::None());
+
+            kstack.clear();
+            kstack.add(pos.key());
+
+            sl = SearchLimits();
+
+            sl.move_time = time;
+
+            si = SearchInfo(pos);
+
+            si.reset();
+            si.timer.start();
+
+            cluster_forward("ucinewgame");
+            cluster_forward("position fen " + pos.to_fen());
+
+            search_start();
+
+            nodes += si.tnodes;
+        }
+
+        return make_pair(nodes, max(timer.elapsed_time(), i64(1)));
+    };
+
+    ttable = TT(hash);
+    ttable.init();
+
+    auto [snodes, stime] = run();
+
+    if (!cluster_spawn(count)) {
+        cerr << "Could not start cluster workers" << endl;
+        cluster_stop();
+        return;
+    }
+
+    cluster_forward("setoption name Hash value " + to_string(hash));
+
+    auto [cnodes, ctime] = run();
+
+    cluster_stop();
+
+    i64 snps = 1000 * snodes / stime;
+    i64 cnps = 1000 * cnodes / ctime;
+
+    cerr << endl
+         << format("positions    = {:13}", positions.size()) << endl
+         << format("workers      = {:13}", count) << endl
+         << endl
+
+         << "Single process"  << endl
+         << format(" nodes       = {:13}", snodes) << endl
+         << format(" nps         = {:13}", snps) << endl
+         << format(" time        = {:13}", stime) << endl
+         << endl
+
+         << "Cluster"         << endl
+         << format(" nodes       = {:13}", cnodes) << endl
+         << format(" nps         = {:13}", cnps) << endl
+         << format(" time        = {:13}", ctime) << endl
+         << endl
+
+         << format("speedup      = {:13.2f}", double(cnps) / max(snps, i64(1))) << endl;
+}
+
+// Starts count copies of this executable in worker mode and waits until
+// they are ready
+static bool cluster_spawn(int count)
+{
+#if defined(__linux__)
+    signal(SIGPIPE, SIG_IGN);
+
+    string share = "share=" + to_string(ClusterShareDepth);
+
+    for (int i = 0; i < count; i++) {
+        int sv[2];
+
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0)
+            return false;
+
+        pid_t pid = fork();
+
+        if (pid < 0) {
+            close(sv[0]);
+            close(sv[1]);
+            return false;
+        }
+
+        if (pid == 0) {
+            dup2(sv[1], STDIN_FILENO);
+            dup2(sv[1], STDOUT_FILENO);
+
+            execl("/proc/self/exe", "cadie", "cluster", "worker", share.c_str(), (char *)nullptr);
+            _exit(EXIT_FAILURE);
+        }
+
+        close(sv[1]);
+
+        ClusterWorker w;
+
+        w.pid = pid;
+        w.fd  = sv[0];
+
+        workers.push_back(w);
+    }
+
+    for (ClusterWorker& w : workers)
+        cluster_send(w, "isready");
+
+    size_t ready = 0;
+
+    Timer timer(true);
+
+    while (ready < workers.size() && timer.elapsed_time() < 10000)
+        cluster_poll(10, [&](ClusterWorker&, const string& line) { ready += line == "readyok"; });
+
+    return ready == workers.size();
+#else
+    (void)count;
+
+    return false;
+#endif
+}
+
+static void cluster_stop()
+{
+#if defined(__linux__)
+    for (ClusterWorker& w : workers) {
+        cluster_send(w, "quit");
+
+        if (w.fd >= 0)
+            close(w.fd);
+
+        if (w.pid > 0)
+            waitpid(w.pid, nullptr, 0);
+    }
+#endif
+
+    workers.clear();
+}
+
+static void cluster_send([[maybe_unused]] ClusterWorker& w, [[maybe_unused]] const string& s)
+{
+#if defined(__linux__)
+    string line = s + '\n';
+
+    size_t sent = 0;
+
+    while (w.fd >= 0 && sent < line.size()) {
+        ssize_t n = write(w.fd, line.data() + sent, line.size() - sent);
+
+        if (n <= 0) {
+            close(w.fd);
+
+            w.fd   = -1;
+            w.done = true;
+        }
+        else
+            sent += n;
+    }
+#endif
+}
+
+// Waits up to timeout ms for output from the workers and hands every
+// complete line to handle
+template <class F>
+static void cluster_poll([[maybe_unused]] int timeout, [[maybe_unused]] F handle)
+{
+#if defined(__linux__)
+    vector<pollfd> fds;
+
+    for (const ClusterWorker& w : workers)
+        fds.push_back({ w.fd, POLLIN, 0 });
+
+    if (poll(fds.data(), fds.size(), timeout) <= 0)
+        return;
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        ClusterWorker& w = workers[i];
+
+        if (w.fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+            continue;
+
+        char buf[65536];
+
+        ssize_t n = read(w.fd, buf, sizeof(buf));
+
+        if (n <= 0) {
+            close(w.fd);
+
+            w.fd   = -1;
+            w.done = true;
+
+            continue;
+        }
+
+        w.inbuf.append(buf, n);
+
+        for (size_t pos; (pos = w.inbuf.find('\n')) != string::npos; ) {
+            string line = w.inbuf.substr(0, pos);
+
+            w.inbuf.erase(0, pos + 1);
+
+            handle(w, line);
+        }
+    }
+#endif
+}
@@ -0,0 +1,24 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <string>
+#include "misc.h"
+#include "move.h"
+
+// Worker processes send TT entries of at least this depth to each other
+extern bool ClusterShare;
+extern int  ClusterShareDepth;
+
+void cluster(int argc, char* argv[]);
+
+bool cluster_active();
+bool cluster_worker();
+void cluster_forward(const std::string& line);
+void cluster_iterate();
+
+void cluster_offer(u64 key, Move m, int score, int eval, int depth, u8 bound);
+void cluster_receive(const std::string& line);
+void cluster_apply();
+void cluster_iteration(int depth);
+
+#endif
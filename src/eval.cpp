@@ -1365,13 +1365,9 @@ Value eval_side(const Position& pos, AttackInfo& ai)
     return val;
 }
 
-int eval(const Position& pos)
+// Side to move relative, without tempo
+static int eval_score(const Position& pos)
 {
-    EvalEntry eentry;
-
-    if (etable.get(pos.key(), eentry))
-        return eentry.score + TempoB;
-
     AttackInfo ai = eval_attack_info(pos);
 
     Value val;
@@ -1405,9 +1401,26 @@ int eval(const Position& pos)
 
     if (pos.side() == Black) score = -score;
 
+    return score;
+}
+
+int eval(const Position& pos)
+{
+    EvalEntry eentry;
+
+    if (etable.get(pos.key(), eentry))
+        return eentry.score + TempoB;
+
+    int score = eval_score(pos);
+
     eentry.score = score;
 
     etable.set(pos.key(), eentry);
     
     return score + TempoB;
 }
+
+int eval_uncached(const Position& pos)
+{
+    return eval_score(pos) + TempoB;
+}
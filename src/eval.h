@@ -22,12 +22,13 @@ struct EvalEntry {
 
     Lock lock;
     i16 score;
-    i16 pad;
+    u16 epoch;
 };
 
 extern HashTable<64 * 1024 * 1024, EvalEntry> etable;
 
 int eval(const Position& pos);
+int eval_uncached(const Position& pos);
 
 void eval_init();
 
@@ -1,5 +1,6 @@
 #include <limits>
 #include <cstring>
+#include "bb.h"
 #include "eval.h"
 #include "gen.h"
 #include "history.h"
@@ -17,19 +18,21 @@ void History::reset()
     memset(cont_,     0, sizeof(cont_));
 }
 
-void History::update(const Position& pos, int ply, int depth, Move best_move, const MoveList& quiets)
+void History::update(const Position& pos, int ply, int depth, Move best_move, const MoveList& quiets, u64 threats)
 {
     depth = min(depth, 10);
 
     int bonus = 4 * (depth * depth + 40 * depth - 30);
 
+    u16 code = best_move.encode();
+
     if (Move pm = pos.prev_move(); pm.is_valid()) {
         int dest = pm.dest();
         int piece = pos.square(dest);
 
         // Counter moves
 
-        counters_[pm.is_capture()][piece][dest] = best_move;
+        counters_[pm.is_capture()][piece][dest] = code;
 
         // Continuation heuristic
 
@@ -46,23 +49,23 @@ void History::update(const Position& pos, int ply, int depth, Move best_move, co
 
     // Killer moves
     
-    if (killers_[sd][ply][0] != best_move) {
+    if (killers_[sd][ply][0] != code) {
         killers_[sd][ply][1] = killers_[sd][ply][0];
-        killers_[sd][ply][0] = best_move;
+        killers_[sd][ply][0] = code;
     }
 
     // Quiet heuristic
 
     if (quiets.size() > 1 || depth > 1) {
-        update(&quiets_[best_move.index(sd)], bonus);
+        update(quiet_ptr(pos, best_move, threats), bonus);
 
         for (Move m : quiets)
             if (m != best_move)
-                update(&quiets_[m.index(sd)], -bonus);
+                update(quiet_ptr(pos, m, threats), -bonus);
     }
 }
 
-void History::specials(const Position& pos, int ply, Move& killer1, Move& killer2, Move& counter) const
+void History::specials(const Position& pos, int ply, u16& killer1, u16& killer2, u16& counter) const
 {
     Side sd = pos.side();
 
@@ -79,8 +82,8 @@ void History::specials(const Position& pos, int ply, Move& killer1, Move& killer
 
 void History::reset_killers(Side sd, int ply)
 {
-    killers_[sd][ply][0] = Move::None();
-    killers_[sd][ply][1] = Move::None();
+    killers_[sd][ply][0] = 0;
+    killers_[sd][ply][1] = 0;
 }
 
 i16 * History::cont_ptr(const Position& pos, Move m)
@@ -98,9 +101,20 @@ i16 * History::cont_ptr(const Position& pos, Move m)
     return &cont_[cap][otype12][odest][mtype6][mdest];
 }
 
-int History::score(const Position& pos, Move m) const
+i16 * History::quiet_ptr(const Position& pos, Move m, u64 threats)
+{
+    bool oatt = bb::test(threats, m.orig());
+    bool datt = bb::test(threats, m.dest());
+
+    return &quiets_[oatt][datt][m.index(pos.side())];
+}
+
+int History::score(const Position& pos, Move m, u64 threats) const
 {
-    int score = quiets_[m.index(pos.side())];
+    bool oatt = bb::test(threats, m.orig());
+    bool datt = bb::test(threats, m.dest());
+
+    int score = quiets_[oatt][datt][m.index(pos.side())];
 
     if (Move pm = pos.prev_move(); pm.is_valid()) {
         int morig =  m.orig();
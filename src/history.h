@@ -17,23 +17,27 @@ public:
     static constexpr int HistoryMax = 16384;
 
     void reset();
-    void update(const Position& pos, int ply, int depth, Move best_move, const MoveList& quiets);
-    void specials(const Position& pos, int ply, Move& killer1, Move& killer2, Move& counter) const;
+    void update(const Position& pos, int ply, int depth, Move best_move, const MoveList& quiets, u64 threats);
+    void specials(const Position& pos, int ply, u16& killer1, u16& killer2, u16& counter) const;
     void reset_killers(Side sd, int ply);
 
-    int score(const Position& pos, Move m) const;
+    int score(const Position& pos, Move m, u64 threats) const;
 
 private:
 
+    i16 * quiet_ptr(const Position& pos, Move m, u64 threats);
+
     i16 * cont_ptr(const Position& pos, Move m);
 
     void update(i16 * p, int bonus);
 
     i16 cont_[2][12][64][6][64];
-    i16 quiets_[8192];
+    // Indexed by origin attacked, destination attacked, and move
+    i16 quiets_[2][2][8192];
 
-    Move killers_[2][PliesMax + 2][2];
-    Move counters_[2][12][64];
+    // Killers and counters are kept in Move::encode form
+    u16 killers_[2][PliesMax + 2][2];
+    u16 counters_[2][12][64];
 };
 
 #endif
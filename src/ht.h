@@ -1,10 +1,8 @@
 #ifndef HT_H
 #define HT_H
 
-#include <bit>
 #include <vector>
 #include <cstdint>
-#include <cstring>
 #include "mem.h"
 
 template <std::size_t Bytes, class T>
@@ -18,9 +16,15 @@ public:
         entries_.resize(Count);
     }
 
+    // Entries from an older epoch count as empty, so clearing only needs a
+    // physical wipe when the epoch counter wraps around
+
     void reset()
     {
-        std::memset((void *)entries_.data(), 0, Bytes);
+        if (++epoch_ == 0) {
+            mem::clear(entries_.data(), Bytes);
+            epoch_ = 1;
+        }
     }
 
     std::size_t permille() const
@@ -28,7 +32,7 @@ public:
         std::size_t count = 0;
 
         for (std::size_t i = 0; i < 1000; i++)
-            count += entries_[i].lock != 0;
+            count += entries_[i].epoch == epoch_;
 
         return count;
     }
@@ -41,7 +45,7 @@ public:
 
         dst.lock = key >> (64 - T::LockBits);
 
-        if (dst.lock == src.lock) {
+        if (dst.lock == src.lock && src.epoch == epoch_) {
             hits_++;
 
             dst = src;
@@ -54,7 +58,8 @@ public:
     
     void set(uint64_t key, T& src)
     {
-        src.lock = key >> (64 - T::LockBits);
+        src.lock  = key >> (64 - T::LockBits);
+        src.epoch = epoch_;
 
         entries_[key & Mask] = src;
     }
@@ -69,6 +74,8 @@ public:
 private:
     std::vector<T> entries_;
 
+    decltype(T::epoch) epoch_ = 1;
+
     std::size_t hits_ = 0;
     std::size_t gets_ = 0;
 };
@@ -6,6 +6,8 @@
 #include "attacks.h"
 #include "bb.h"
 #include "bench.h"
+#include "cluster.h"
+#include "micro.h"
 #include "gen.h"
 #include "misc.h"
 #include "perft.h"
@@ -23,8 +25,11 @@ static void help(string exe)
 {
     cout << "Usage: " << exe << " [options]" << endl
          << "Options:" << endl
-         << "  bench [depth=N] [file=path] [num=N] [hash=MB] [nodes=N] [random] [time=ms] [mates] [option.K=V]" << endl
-         << "  perft [depth=N] [file=path] [num=N] [report=N]" << endl;
+         << "  bench [depth=N] [file=path] [num=N] [hash=MB] [nodes=N] [random] [time=ms] [mates] [option.K=V] [json[=path]] [compare=path] [concurrency=N] [counters]" << endl
+         << "  perft [depth=N] [file=path] [num=N] [report=N] [counters]" << endl
+         << "  micro [file=path] [num=N] [samples=N] [warmup=N] [filter=name]" << endl
+         << "  cluster [workers=N] [share=depth]" << endl
+         << "  cluster test [workers=N] [file=path] [num=N] [hash=MB] [time=ms]" << endl;
 }
 
 int main(int argc, char* argv[])
@@ -42,9 +47,13 @@ int main(int argc, char* argv[])
 
     if (tokens.size() >= 2) {
         if (tokens[1] == "bench")
-            benchmark(argc - 2, argv + 2);
+            return benchmark(argc - 2, argv + 2);
         else if (tokens[1] == "perft")
             perft(argc - 2, argv + 2);
+        else if (tokens[1] == "micro")
+            microbench(argc - 2, argv + 2);
+        else if (tokens[1] == "cluster")
+            cluster(argc - 2, argv + 2);
         else
             help(tokens[0]);
 
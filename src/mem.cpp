@@ -1,10 +1,16 @@
+#include <algorithm>
 #include <fstream>
 #include <iterator>
+#include <thread>
 #include <vector>
 #include <cstdlib>
+#include <cstring>
 
 #if defined(__linux__)
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #ifdef _MSC_VER
@@ -57,6 +63,37 @@ void prefetch(void * p)
 #endif
 }
 
+// Zeroes large blocks with one thread per core, which is considerably
+// faster than a single memset once the block no longer fits in cache
+
+void clear(void * p, size_t size)
+{
+    constexpr size_t chunk_min = 64 * 1024 * 1024;
+
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+    threads = std::min(threads, size / chunk_min + 1);
+
+    if (threads == 1) {
+        std::memset(p, 0, size);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+
+    size_t chunk = size / threads;
+
+    for (size_t i = 0; i < threads; i++) {
+        uint8_t * begin = static_cast<uint8_t *>(p) + i * chunk;
+        size_t bytes = i == threads - 1 ? size - i * chunk : chunk;
+
+        workers.emplace_back([=]() { std::memset(begin, 0, bytes); });
+    }
+
+    for (std::thread& t : workers)
+        t.join();
+}
+
 std::vector<uint8_t> read(std::string filename)
 {
     std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
@@ -80,4 +117,108 @@ void write(const void * p, size_t size, std::string filename)
     ofs.write(reinterpret_cast<const char *>(p), size);
 }
 
+// Maps a file with private copy-on-write pages, so its contents are only
+// read from disk as they are touched. Returns nullptr on failure.
+
+void * map(std::string filename, size_t& size)
+{
+#if defined(__linux__)
+    int fd = open(filename.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    size = st.st_size;
+
+    void * p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    return p == MAP_FAILED ? nullptr : p;
+#else
+    std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+
+    if (!ifs)
+        return nullptr;
+
+    size = ifs.tellg();
+
+    ifs.seekg(0, std::ios::beg);
+
+    void * p = alloc(size);
+
+    if (!ifs.read(static_cast<char *>(p), size)) {
+        free(p);
+        return nullptr;
+    }
+
+    return p;
+#endif
+}
+
+// Opens or creates a named shared memory segment of size bytes and maps it
+// read-write. An existing segment keeps its size, which is returned in size.
+// New segments are zero-filled. Returns nullptr on failure.
+
+void * map_shared([[maybe_unused]] std::string name, [[maybe_unused]] size_t& size, bool& created)
+{
+    created = false;
+
+#if defined(__linux__)
+    if (name.empty() || name[0] != '/')
+        name = "/" + name;
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+
+    if (fd >= 0) {
+        created = true;
+
+        if (ftruncate(fd, size) < 0) {
+            close(fd);
+            shm_unlink(name.c_str());
+            return nullptr;
+        }
+    }
+    else {
+        fd = shm_open(name.c_str(), O_RDWR, 0666);
+
+        struct stat st;
+
+        if (fd < 0)
+            return nullptr;
+
+        if (fstat(fd, &st) < 0 || st.st_size == 0) {
+            close(fd);
+            return nullptr;
+        }
+
+        size = st.st_size;
+    }
+
+    void * p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    return p == MAP_FAILED ? nullptr : p;
+#else
+    return nullptr;
+#endif
+}
+
+void unmap(void * p, [[maybe_unused]] size_t size)
+{
+#if defined(__linux__)
+    munmap(p, size);
+#else
+    free(p);
+#endif
+}
+
 }
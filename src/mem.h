@@ -10,10 +10,16 @@ namespace mem {
 void * alloc(size_t size);
 void free(void * p);
 void prefetch(void * p);
+void clear(void * p, size_t size);
 
 std::vector<uint8_t> read(std::string filename);
 void write(const void * p, size_t size, std::string filename);
 
+void * map(std::string filename, size_t& size);
+void unmap(void * p, size_t size);
+
+void * map_shared(std::string name, size_t& size, bool& created);
+
 }
 
 #endif
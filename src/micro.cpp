@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "bb.h"
+#include "eval.h"
+#include "gen.h"
+#include "history.h"
+#include "micro.h"
+#include "misc.h"
+#include "order.h"
+#include "pos.h"
+#include "string.h"
+#include "timer.h"
+using namespace std;
+
+// Times single kernels over the positions of an EPD file. Each kernel is
+// repeated until one pass takes at least a few milliseconds, warmed up, and
+// then sampled; the median and its median absolute deviation are in ns per
+// operation.
+
+struct Micro {
+    size_t num      = 100;
+    size_t samples  =  25;
+    size_t warmup   =   3;
+
+    string filter;
+
+    filesystem::path path { "bench.epd" };
+
+    vector<Position> positions;
+};
+
+// Keeps the compiler from dropping the timed work
+static volatile u64 Sink;
+
+static History MicroHistory;
+
+static void micro_input(Micro& mc);
+static void micro_go   (Micro& mc);
+
+static double median(vector<double> v)
+{
+    sort(v.begin(), v.end());
+
+    size_t n = v.size();
+
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+template <class F>
+static void micro_run(const Micro& mc, const string& name, size_t ops, F pass)
+{
+    if (!mc.filter.empty() && name.find(mc.filter) == string::npos)
+        return;
+
+    if (ops == 0)
+        return;
+
+    constexpr i64 PassMinNs = 2'000'000;
+
+    u64 sink = 0;
+
+    auto timed = [&](size_t reps) {
+        Timer timer(true);
+
+        for (size_t r = 0; r < reps; r++)
+            sink += pass();
+
+        timer.stop();
+
+        return timer.elapsed_time<Timer::Nano>();
+    };
+
+    size_t reps = 1;
+
+    while (timed(reps) < PassMinNs)
+        reps *= 2;
+
+    for (size_t i = 0; i < mc.warmup; i++)
+        timed(reps);
+
+    vector<double> ns;
+
+    for (size_t i = 0; i < mc.samples; i++)
+        ns.push_back(double(timed(reps)) / (reps * ops));
+
+    double med = median(ns);
+
+    vector<double> dev;
+
+    for (double x : ns)
+        dev.push_back(abs(x - med));
+
+    cout << format("{:<24} {:10} {:12.2f} {:10.2f}", name, ops, med, median(dev)) << endl;
+
+    Sink = Sink + sink;
+}
+
+void microbench(int argc, char* argv[])
+{
+    Tokenizer fields(argc, argv);
+
+    Micro mc;
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        Tokenizer args(fields[i], '=');
+
+        string k = args.get(0);
+        string v = args.get(1, "");
+
+        if (k == "file")
+            mc.path = filesystem::path { v };
+        else if (k == "filter")
+            mc.filter = v;
+        else if (k == "num")
+            mc.num = stoull(v);
+        else if (k == "samples")
+            mc.samples = max<size_t>(stoull(v), 1);
+        else if (k == "warmup")
+            mc.warmup = stoull(v);
+        else {
+            cerr << "Unknown option: " << k << endl;
+            return;
+        }
+    }
+
+    micro_input(mc);
+
+    if (mc.positions.empty()) {
+        cerr << "No positions in " << mc.path.string() << endl;
+        return;
+    }
+
+    micro_go(mc);
+}
+
+void micro_go(Micro& mc)
+{
+    vector<Position>& positions = mc.positions;
+
+    // Move lists are generated up front, so per-move kernels time only
+    // themselves
+    vector<MoveList> pseudos(positions.size());
+    vector<MoveList> legals(positions.size());
+    vector<MoveList> tacticals(positions.size());
+
+    size_t npseudo = 0;
+    size_t nlegal = 0;
+    size_t ntactical = 0;
+    size_t nquiet = 0;
+
+    for (size_t i = 0; i < positions.size(); i++) {
+        npseudo   += gen_moves(pseudos[i],   positions[i], GenMode::Pseudo);
+        nlegal    += gen_moves(legals[i],    positions[i], GenMode::Legal);
+        ntactical += gen_moves(tacticals[i], positions[i], GenMode::Tactical);
+
+        nquiet    += !positions[i].checkers();
+    }
+
+    MicroHistory.reset();
+
+    cout << format("{:<24} {:>10} {:>12} {:>10}", "kernel", "ops", "ns/op", "mad") << endl;
+
+    const pair<GenMode, const char *> modes[] = {
+        { GenMode::Pseudo,   "gen_moves Pseudo" },
+        { GenMode::Legal,    "gen_moves Legal" },
+        { GenMode::Tactical, "gen_moves Tactical" },
+    };
+
+    for (auto [mode, name] : modes) {
+        micro_run(mc, name, positions.size(), [&, mode]() {
+            u64 n = 0;
+            MoveList moves;
+
+            for (const auto& pos : positions) {
+                moves.clear();
+                n += gen_moves(moves, pos, mode);
+            }
+
+            return n;
+        });
+    }
+
+    // Only called outside of check, as in qsearch
+    micro_run(mc, "add_checks", nquiet, [&]() {
+        u64 n = 0;
+        MoveList moves;
+
+        for (const auto& pos : positions) {
+            if (pos.checkers()) continue;
+
+            moves.clear();
+            n += add_checks(moves, pos);
+        }
+
+        return n;
+    });
+
+    micro_run(mc, "make_move/unmake_move", nlegal, [&]() {
+        u64 n = 0;
+
+        for (size_t i = 0; i < positions.size(); i++) {
+            Position& pos = positions[i];
+            UndoInfo undo = pos.undo_info();
+
+            for (Move m : legals[i]) {
+                pos.make_move(m);
+                n += pos.key();
+                pos.unmake_move(undo);
+            }
+        }
+
+        return n;
+    });
+
+    micro_run(mc, "see", ntactical, [&]() {
+        u64 n = 0;
+
+        for (size_t i = 0; i < positions.size(); i++)
+            for (Move m : tacticals[i])
+                n += positions[i].see(m);
+
+        return n;
+    });
+
+    micro_run(mc, "move_is_legal", npseudo, [&]() {
+        u64 n = 0;
+
+        for (size_t i = 0; i < positions.size(); i++)
+            for (Move m : pseudos[i])
+                n += positions[i].move_is_legal(m);
+
+        return n;
+    });
+
+    micro_run(mc, "eval (no etable)", positions.size(), [&]() {
+        u64 n = 0;
+
+        for (const auto& pos : positions)
+            n += eval_uncached(pos);
+
+        return n;
+    });
+
+    // Each attack function gets its own instantiation, so it is inlined
+    auto sliders = [&](const string& name, auto attacks) {
+        micro_run(mc, name, 64 * positions.size(), [&]() {
+            u64 n = 0;
+
+            for (const auto& pos : positions) {
+                u64 occ = pos.occ();
+
+                for (int sq = 0; sq < 64; sq++)
+                    n += attacks(sq, occ);
+            }
+
+            return n;
+        });
+    };
+
+    sliders("Leorik::Bishop", [](int sq, u64 occ) { return bb::Leorik::Bishop(sq, occ); });
+    sliders("Leorik::Rook",   [](int sq, u64 occ) { return bb::Leorik::Rook  (sq, occ); });
+    sliders("Leorik::Queen",  [](int sq, u64 occ) { return bb::Leorik::Queen (sq, occ); });
+
+    // Main search, qsearch with checks, and qsearch captures only
+    const pair<int, const char *> orders[] = {
+        {  4, "Order search" },
+        {  0, "Order qsearch checks" },
+        { -1, "Order qsearch" },
+    };
+
+    for (auto [depth, name] : orders) {
+        micro_run(mc, name, positions.size(), [&, depth]() {
+            u64 n = 0;
+
+            for (auto& pos : positions) {
+                Order order(pos, MicroHistory, Move::None(), 0, depth);
+                n += u32(order.next());
+            }
+
+            return n;
+        });
+    }
+}
+
+void micro_input(Micro& mc)
+{
+    ifstream ifs(mc.path);
+
+    for (string line; getline(ifs, line) && mc.positions.size() < mc.num; ) {
+        if (line.empty() || line[0] == '#') continue;
+
+        Tokenizer fields(line, ',');
+
+        mc.positions.emplace_back(fields[0]);
+    }
+}
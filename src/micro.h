@@ -0,0 +1,6 @@
+#ifndef MICRO_H
+#define MICRO_H
+
+void microbench(int argc, char* argv[]);
+
+#endif
@@ -2,6 +2,7 @@
 #define MISC_H
 
 #include <cstdint>
+#include <cstring>
 #include "list.h"
 
 constexpr char CADIE_VERSION[] = "2.1";
@@ -17,7 +18,49 @@ typedef int16_t i16;
 typedef int32_t i32;
 typedef int64_t i64;
 
-using KeyStack = List<u64, 1024>;
+__extension__ typedef unsigned __int128 u128;
+
+// Position keys along the game and search path. A small table of counters
+// indexed by the low key bits filters out most repetition scans.
+
+class KeyStack {
+public:
+    static constexpr std::size_t FilterSize = 1 << 16;
+    static constexpr std::size_t FilterMask = FilterSize - 1;
+
+    void clear()
+    {
+        keys_.clear();
+
+        std::memset(filter_, 0, sizeof(filter_));
+    }
+
+    void add(u64 key)
+    {
+        keys_.add(key);
+
+        filter_[key & FilterMask]++;
+    }
+
+    void pop_back()
+    {
+        filter_[keys_.back() & FilterMask]--;
+
+        keys_.pop_back();
+    }
+
+    // False positives are possible, false negatives are not
+    bool maybe_rep(u64 key) const { return filter_[key & FilterMask] > 1; }
+
+    u64 back(std::size_t i = 0) const { return keys_.back(i); }
+
+    std::size_t size() const { return keys_.size(); }
+
+private:
+    List<u64, 1024> keys_;
+
+    u8 filter_[FilterSize] = { };
+};
 
 constexpr int DepthMin =  -4;
 constexpr int DepthMax = 120;
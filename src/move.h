@@ -80,6 +80,16 @@ public:
     int index(      )       const { return  data_ & 0xfff; }
     int index(int sd)       const { return (data_ & 0xfff) | (sd << 12); }
 
+    // Compact form for tables: orig, dest and the promotion piece in 2 bits
+    // (knight to queen). Position::decode restores the remaining flags.
+
+    u16 encode() const
+    {
+        u16 promo = is_promo() ? (this->promo() - Knight) << 12 : 0;
+
+        return u16(data_ & 0xfff) | promo;
+    }
+
     std::string str() const
     {
         std::ostringstream oss;
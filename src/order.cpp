@@ -22,13 +22,16 @@ Order::Order(Position& pos, const History& history, Move best_move, int ply, int
     else
         gen_moves(moves, pos, tactical ? GenMode::Tactical : GenMode::Pseudo);
 
-    Move killer1 = Move::None();
-    Move killer2 = Move::None();
-    Move counter = Move::None();
+    u16 killer1 = 0;
+    u16 killer2 = 0;
+    u16 counter = 0;
 
-    if (!tactical)
+    if (!tactical) {
         history.specials(pos, ply, killer1, killer2, counter);
 
+        threats_ = pos.attacks(!pos.side());
+    }
+
     for (size_t i = 0; i < moves.size(); i++) {
         Move m = moves[i];
 
@@ -52,14 +55,16 @@ Order::Order(Position& pos, const History& history, Move best_move, int ply, int
         }
 
         else if (!tactical) {
-            if (m == killer1)
+            u16 code = m.encode();
+
+            if (code == killer1)
                 score = ScoreKiller1;
-            else if (m == killer2)
+            else if (code == killer2)
                 score = ScoreKiller2;
-            else if (m == counter)
+            else if (code == counter)
                 score = ScoreCounter;
             else
-                score = history.score(pos, m);
+                score = history.score(pos, m, threats_);
         }
 
         emoves_[count_++] = ExtMove::make(m, score);
@@ -89,10 +94,10 @@ Move Order::next()
     if (index_ >= count_)
         return Move::None();
 
-    u64 move_max = 0;
+    u64 move_max = sorted_ ? emoves_[index_] : 0;
     size_t index_max = index_;
 
-    for (size_t i = index_; i < count_; i++) {
+    for (size_t i = index_; i < count_ && !sorted_; i++) {
         if (ExtMove::score(emoves_[i]) > ExtMove::score(move_max)) {
             move_max = emoves_[i];
             index_max = i;
@@ -113,6 +118,31 @@ Move Order::next()
     return move_;
 }
 
+// Root moves are searched hash move first, then by the size of their
+// subtrees so far. Scores are kept for pruning and reductions.
+void Order::sort_root(const vector<RootMove>& rmoves)
+{
+    auto nodes = [&](u64 em) {
+        if (ExtMove::score(em) == ScoreTT)
+            return numeric_limits<i64>::max();
+
+        for (const RootMove& rm : rmoves)
+            if (rm.move == ExtMove::move(em))
+                return rm.nodes;
+
+        return i64(0);
+    };
+
+    stable_sort(emoves_, emoves_ + count_, [&](u64 a, u64 b) {
+        i64 na = nodes(a);
+        i64 nb = nodes(b);
+
+        return na != nb ? na > nb : ExtMove::score(a) > ExtMove::score(b);
+    });
+
+    sorted_ = true;
+}
+
 bool Order::singular() const
 {
     return count_ == 1;
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <limits>
+#include <vector>
 #include "history.h"
 #include "move.h"
 #include "search.h"
@@ -33,10 +34,14 @@ struct Order {
 
     Move next();
 
+    void sort_root(const std::vector<RootMove>& rmoves);
+
     bool singular() const;
     int see();
     int score() const;
 
+    u64 threats() const { return threats_; }
+
 private:
     std::size_t index_ = 0;
 
@@ -44,6 +49,12 @@ private:
     int see_;
     int score_;
 
+    // Squares attacked by the opponent
+    u64 threats_ = 0;
+
+    // Moves are already in search order
+    bool sorted_ = false;
+
     std::size_t count_ = 0;
     u64 emoves_[128];
 
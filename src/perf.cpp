@@ -0,0 +1,155 @@
+#include <format>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "perf.h"
+using namespace std;
+
+static const char * EventNames[] = {
+    "instructions", "cycles", "L1D misses", "LLC misses", "branch misses", "dTLB misses"
+};
+
+PerfCounters::~PerfCounters()
+{
+#if defined(__linux__)
+    for (int fd : fds_)
+        if (fd >= 0)
+            close(fd);
+#endif
+}
+
+bool PerfCounters::open()
+{
+#if defined(__linux__)
+    auto cache = [](u64 id, u64 result) {
+        return id | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+    };
+
+    const pair<u32, u64> events[EventCount] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+        { PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+    };
+
+    bool any = false;
+
+    for (int e = 0; e < EventCount; e++) {
+        perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+
+        attr.size           = sizeof(attr);
+        attr.type           = events[e].first;
+        attr.config         = events[e].second;
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+
+        // Counters are multiplexed if the PMU has too few of them
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        fds_[e] = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+
+        if (fds_[e] >= 0)
+            any = true;
+        else if (error_.empty())
+            error_ = strerror(errno);
+    }
+
+    if (!any) {
+        ifstream ifs("/proc/sys/kernel/perf_event_paranoid");
+
+        if (int paranoid; ifs >> paranoid)
+            error_ += format(" (perf_event_paranoid = {})", paranoid);
+    }
+
+    return any;
+#else
+    error_ = "not supported on this platform";
+
+    return false;
+#endif
+}
+
+void PerfCounters::start()
+{
+#if defined(__linux__)
+    for (int fd : fds_)
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+void PerfCounters::stop()
+{
+#if defined(__linux__)
+    for (int fd : fds_)
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+#endif
+}
+
+u64 PerfCounters::count(Event e) const
+{
+#if defined(__linux__)
+    u64 data[3] = { 0, 0, 0 };
+
+    if (fds_[e] < 0 || read(fds_[e], data, sizeof(data)) != sizeof(data))
+        return 0;
+
+    // value, time enabled, time running
+    if (data[2] == 0)
+        return 0;
+
+    return data[2] < data[1] ? u64(double(data[0]) * data[1] / data[2]) : data[0];
+#else
+    (void)e;
+
+    return 0;
+#endif
+}
+
+void PerfCounters::print(ostream& os, i64 units, const string& unit) const
+{
+    bool any = false;
+
+    for (int fd : fds_)
+        any |= fd >= 0;
+
+    if (!any) {
+        os << "counters unavailable: " << error_ << endl;
+        return;
+    }
+
+    string per = " / " + unit;
+
+    for (int e = 0; e < EventCount; e++) {
+        if (!available(Event(e))) {
+            os << format("{:<13}= {:>13}", EventNames[e], "n/a") << endl;
+            continue;
+        }
+
+        u64 n = count(Event(e));
+
+        os << format("{:<13}= {:13}  {:10.2f}{}", EventNames[e], n, units ? double(n) / units : 0.0, per) << endl;
+    }
+
+    if (available(Instructions) && available(Cycles)) {
+        u64 cycles = count(Cycles);
+
+        os << format("{:<13}= {:13.2f}", "IPC", cycles ? double(count(Instructions)) / cycles : 0.0) << endl;
+    }
+}
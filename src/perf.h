@@ -0,0 +1,40 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <array>
+#include <ostream>
+#include <string>
+#include "misc.h"
+
+// Hardware event counters of the calling thread (Linux perf_event_open).
+// Events the kernel or the CPU refuses are left out; if none can be opened,
+// everything reads as zero and print says why.
+
+class PerfCounters {
+public:
+    enum Event { Instructions, Cycles, L1DMisses, LLCMisses, BranchMisses, DTLBMisses, EventCount };
+
+    PerfCounters() { fds_.fill(-1); }
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool open();
+
+    void start();
+    void stop();
+
+    bool available(Event e) const { return fds_[e] >= 0; }
+    u64 count(Event e) const;
+
+    // Counts per unit (nodes, leaves), plus IPC
+    void print(std::ostream& os, i64 units, const std::string& unit) const;
+
+private:
+    std::array<int, EventCount> fds_;
+
+    std::string error_;
+};
+
+#endif
@@ -15,6 +15,7 @@
 #include "gen.h"
 #include "misc.h"
 #include "move.h"
+#include "perf.h"
 #include "perft.h"
 #include "pos.h"
 #include "search.h"
@@ -48,6 +49,8 @@ struct PerftInfo {
     size_t micros   =   0;
     size_t cycles   =   0;
 
+    bool counters   = false;
+
     filesystem::path path { "perft.epd" };
 
     vector<FenInfo> finfos;
@@ -104,7 +107,7 @@ static void perft_input(PerftInfo& pinfo)
     }
 }
 
-static void perft_go(PerftInfo &pinfo)
+static void perft_go(PerftInfo &pinfo, PerfCounters& counters)
 {
     i64 invalid = 0;
 
@@ -118,7 +121,9 @@ static void perft_go(PerftInfo &pinfo)
         const i64 leaves_req = fi.leaves[pinfo.depth - 1];
 
         Timer timer(true);
+        counters.start();
         i64 leaves = perft(pos, pinfo.depth);
+        counters.stop();
         timer.stop();
 
         const i64 micros = timer.elapsed_time<Timer::Micro>();
@@ -162,10 +167,12 @@ void perft(int argc, char* argv[])
     for (size_t i = 0; i < fields.size(); i++) {
         Tokenizer args(fields[i], '=');
 
-        string k = args[0];
-        string v = args[1];
+        string k = args.get(0);
+        string v = args.get(1, "");
 
-        if (k == "depth") {
+        if (k == "counters")
+            pinfo.counters = true;
+        else if (k == "depth") {
             size_t n = stoull(v);
             pinfo.depth = n;
 
@@ -188,12 +195,20 @@ void perft(int argc, char* argv[])
         }
     }
 
+    PerfCounters counters;
+
+    if (pinfo.counters)
+        counters.open();
+
     perft_input(pinfo);
-    perft_go(pinfo);
+    perft_go(pinfo, counters);
 
     cout << "leaves:   " << pinfo.leaves << endl
          << "millis:   " << pinfo.micros / 1000 << endl
          << "klps:     " << 1000 * pinfo.leaves / pinfo.micros << endl
          << "cpl:      " << pinfo.cycles / pinfo.leaves << endl
          << "illegals: " << pinfo.illegals << endl;
+
+    if (pinfo.counters)
+        counters.print(cout, pinfo.leaves, "leaf");
 }
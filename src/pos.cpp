@@ -196,6 +196,93 @@ Move Position::note_move(const string& s) const
     return m;
 }
 
+// Restores a move packed by Move::encode, or returns Move::None() if the
+// move is not pseudo-legal here (hash collisions, stale killers)
+Move Position::decode(u16 data) const
+{
+    int orig = data & 0x3f;
+    int dest = (data >> 6) & 0x3f;
+
+    if (orig == dest)
+        return Move::None();
+
+    Piece12 pt12  = square_[orig];
+    Piece12 xpt12 = square_[dest];
+
+    if (pt12 == None12 || pt12 % 2 != side_)
+        return Move::None();
+
+    if (xpt12 != None12 && (xpt12 % 2 == side_ || xpt12 / 2 == King))
+        return Move::None();
+
+    u64 occ = this->occ();
+
+    Move m(orig, dest, xpt12);
+
+    switch (pt12 / 2) {
+    case Pawn: {
+        int incr = square::incr(side_);
+
+        if (dest == orig + incr) {
+            if (xpt12 != None12)
+                return Move::None();
+        }
+        else if (dest == orig + 2 * incr) {
+            if (xpt12 != None12 || square::rank(orig, side_) != Rank2 || !empty(orig + incr))
+                return Move::None();
+
+            return m | Move::DoubleFlag;
+        }
+        else if (bb::test(PawnAttacks[side_][orig], dest)) {
+            if (dest == ep_sq_)
+                return Move(orig, dest, WP12 + !side_) | Move::EPFlag;
+
+            if (xpt12 == None12)
+                return Move::None();
+        }
+        else
+            return Move::None();
+
+        if (square::rank(dest, side_) == Rank8)
+            return m | (u32(Knight + ((data >> 12) & 3)) << 20);
+
+        return m.is_capture() ? m : Move(m | Move::SingleFlag);
+    }
+
+    case Knight:
+        return bb::test(KnightAttacks[orig], dest) ? m : Move::None();
+
+    case Bishop:
+    case Rook:
+    case Queen: {
+        const u64 * attacks = pt12 / 2 == Bishop ? BishopAttacks
+                            : pt12 / 2 == Rook   ? RookAttacks
+                            :                      QueenAttacks;
+
+        if (!bb::test(attacks[orig], dest) || (bb::Between[orig][dest] & occ))
+            return Move::None();
+
+        return m;
+    }
+
+    case King:
+        if (bb::test(KingAttacks[orig], dest))
+            return m;
+
+        if (dest == orig + 2 && can_castle_k() && !(bb::Between[orig][orig + 3] & occ))
+            return m | Move::CastleFlag;
+
+        if (dest == orig - 2 && can_castle_q() && !(bb::Between[orig][orig - 4] & occ))
+            return m | Move::CastleFlag;
+
+        return Move::None();
+
+    case None6:
+    default:
+        return Move::None();
+    }
+}
+
 void Position::make_move(Move m)
 {
     key_ ^= zob::castle(flags_);
@@ -943,6 +1030,9 @@ bool Position::draw_fifty() const
 
 bool Position::draw_rep() const
 {
+    if (!kstack.maybe_rep(key_))
+        return false;
+
     for (size_t i = 4; i <= size_t(half_moves_) && i < kstack.size(); i += 2)
         if (kstack.back(i) == kstack.back())
             return true;
@@ -950,6 +1040,36 @@ bool Position::draw_rep() const
     return false;
 }
 
+// Can the side to move reach a position already on the search path with
+// a single reversible move? Only cycles within the search tree are reported.
+bool Position::has_game_cycle(int ply) const
+{
+    int end = min({ int(half_moves_), int(kstack.size()) - 1, ply - 1 });
+
+    if (end < 3)
+        return false;
+
+    u64 occ = this->occ();
+
+    for (int i = 1; i <= end; i++) {
+        if (mstack.back(i - 1) == Move::Null())
+            break;
+
+        if (i < 3 || i % 2 == 0)
+            continue;
+
+        int sq1, sq2;
+
+        if (!zob::cuckoo(key_ ^ kstack.back(i), sq1, sq2))
+            continue;
+
+        if ((bb::Between[sq1][sq2] & occ) == 0)
+            return true;
+    }
+
+    return false;
+}
+
 bool Position::draw() const
 {
     return draw_rep() || draw_dead() || draw_fifty();
@@ -1081,3 +1201,20 @@ u64 Position::static_attacks(Side sd) const
 
     return bb::PawnAttacks(sd, pawns) | bb::KnightAttacks(knights) | KingAttacks[king];
 }
+
+u64 Position::attacks(Side sd) const
+{
+    u64 occ     = this->occ();
+    u64 bishops = bb(sd, Bishop, Queen);
+    u64 rooks   = bb(sd, Rook, Queen);
+
+    u64 att = static_attacks(sd);
+
+    for (u64 bb = bishops; bb; )
+        att |= bb::Leorik::Bishop(bb::pop(bb), occ);
+
+    for (u64 bb = rooks; bb; )
+        att |= bb::Leorik::Rook(bb::pop(bb), occ);
+
+    return att;
+}
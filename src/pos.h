@@ -33,6 +33,7 @@ public:
     Position(const char fen[]) : Position(std::string(fen)) { }
 
     Move note_move(const std::string& s) const;
+    Move decode(u16 data) const;
 
     void   make_move(Move m);
     void unmake_move(const UndoInfo& undo);
@@ -106,6 +107,7 @@ public:
     bool draw_dead  () const;
     bool draw_fifty () const;
     bool draw_rep   () const;
+    bool has_game_cycle(int ply) const;
     bool draw       () const;
 
     int draw_scale(int eval) const { return (200 - half_moves_) * eval / 200; }
@@ -231,6 +233,7 @@ public:
 
     u64 attackers_to(u64 occ, int sq) const;
     u64 static_attacks(Side sd) const;
+    u64 attacks(Side sd) const;
 
 private:
     template <bool UpdateKey> void add_piece(int sq, Piece12 pt12);
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <array>
+#include <condition_variable>
 #include <mutex>
 #include <sstream>
 #include <thread>
@@ -7,6 +8,7 @@
 #include <cmath>
 #include <cstring>
 #include "bench.h"
+#include "cluster.h"
 #include "search.h"
 #include "eval.h"
 #include "gen.h"
@@ -14,12 +16,25 @@
 #include "move.h"
 #include "pos.h"
 #include "order.h"
+#include "stats.h"
 #include "tt.h"
+#include "worker.h"
 
 using namespace std;
 
 atomic_bool Searching = false;
 atomic_bool StopRequest = false;
+atomic_bool PollRequest = false;
+atomic_bool Pondering = false;
+
+static Worker wworker;
+
+static mutex WatchdogMutex;
+static condition_variable WatchdogCond;
+
+// Signalled by stop and ponderhit, which release a finished search
+static condition_variable ReleaseCond;
+static bool WatchdogDone;
 
 SearchInfo      si;
 SearchLimits    sl;
@@ -32,26 +47,32 @@ static u8 LMPruning[2][9];
 static i16 Evals[PliesMax];
 
 static int qsearch(Position& pos, int alfa, const int beta, const int ply, const int depth, PV& pv, bool is_pv);
-static int  search(Position& pos, int alfa,       int beta, const int ply, const int depth, PV& pv, Move skip_move = Move::None());
+static int  search(Position& pos, int alfa,       int beta, const int ply,       int depth, PV& pv, Move skip_move = Move::None());
 
 static int search_aspirate(Position pos, int depth, PV& pv, int score);
 static void search_iterate();
 
+static void watchdog();
+static i64 watchdog_next(i64 dur);
+
 static string pv_string(PV& pv);
 static u8 calc_bound(int score, int alfa, int beta);
 static void pv_append(PV& dst, const PV& src);
 static int calc_reductions(const Node& node, int depth, Move m, Order& order, bool checks);
 
-int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV& pv, Move skip_move)
+int search(Position& pos, int alfa, int beta, const int ply, int depth, PV& pv, Move skip_move)
 {
     if (depth <= 0)
         return qsearch(pos, alfa, beta, ply, 0, pv, beta - alfa > 1);
 
     // Do we need to abort the search?
-    si.checkup();
+    if (si.checkup())
+        return 0;
 
     Node node(pos, alfa, beta);
 
+    STAT_INC(nodes[node.pv_node]);
+
     if (node.pv_node)
         si.sel_depth = max(si.sel_depth, ply + 1);
 
@@ -61,6 +82,14 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
         if (pos.draw())
             return ScoreDraw;
 
+        // upcoming repetition
+
+        if (alfa < ScoreDraw && pos.has_game_cycle(ply)) {
+            alfa = ScoreDraw;
+
+            if (alfa >= beta) return alfa;
+        }
+
         if (ply >= PliesMax)
             return pos.checkers() ? ScoreDraw : eval(pos);
 
@@ -74,13 +103,21 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
 
     node.tthit = !skip_move && ttable.get(node.tte, pos.key(), ply);
 
+    STAT_ADD(tt_probes[node.pv_node], !skip_move);
+    STAT_ADD(tt_hits[node.pv_node], node.tthit);
+
     if (node.tthit) {
+        node.tt_move = pos.decode(node.tte.move);
+
         if (node.tte.depth >= depth && !node.pv_node) {
             bool cut =  node.tte.bound == BoundExact
                     || (node.tte.bound == BoundLower && node.tte.score >= beta)
                     || (node.tte.bound == BoundUpper && node.tte.score <= alfa);
 
-            if (cut) return node.tte.score;
+            if (cut) {
+                STAT_INC(tt_cuts[node.pv_node]);
+                return node.tte.score;
+            }
         }
 
         if (   SingularExt
@@ -90,7 +127,7 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
             && score_is_eval(node.tte.score)
             && (node.tte.bound & BoundLower)
             && node.tte.depth >= depth - SEDepthOffset)
-            node.ext_move = node.tte.move;
+            node.ext_move = node.tt_move;
     }
 
     if (pos.checkers())
@@ -124,7 +161,12 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
     node.improving = Evals[ply] > (ply < 2 ? 0 : Evals[ply - 2]);
 
     if (!ply)
-        node.tte.move = si.best_move;
+        node.tt_move = si.pv_index ? si.rmoves[si.pv_index].move : si.best_move;
+
+    // Internal iterative reduction
+
+    if (IIR && depth >= IIRDepthMin && !skip_move && !node.tt_move)
+        depth--;
 
     history.reset_killers(pos.side(), ply + 2);
 
@@ -133,8 +175,10 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
         if (   StaticNMP
             && depth <= StaticNMPDepthMax
             && pos.pieces(pos.side())
-            && node.eval >= beta + (depth - node.improving) * StaticNMPFactor)
+            && node.eval >= beta + (depth - node.improving) * StaticNMPFactor) {
+            STAT_INC(static_nmp);
             return node.eval;
+        }
 
         if (   NMPruning
             && depth >= NMPruningDepthMin
@@ -146,14 +190,21 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
         {
             int R = 3 + depth / 3;
 
+            STAT_INC(nmp_tries);
+
             UndoInfo undo = pos.undo_info();
 
             pos.make_null();
             int score = -search(pos, -beta, -beta + 1, ply + 1, depth - R, node.pv);
             pos.unmake_null(undo);
 
-            if (score >= beta)
+            if (si.aborted)
+                return 0;
+
+            if (score >= beta) {
+                STAT_INC(nmp_cuts);
                 return !score_is_eval(score) ? beta : score;
+            }
         }
 
         int ubound = beta + 175;
@@ -162,7 +213,9 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
             && score_is_eval(beta)
             && !(node.tthit && node.tte.depth >= depth - 3 && node.tte.score < ubound))
         {
-            Order order(pos, node.tte.move);
+            Order order(pos, node.tt_move);
+
+            STAT_INC(probcut_tries);
 
             UndoInfo undo = pos.undo_info();
 
@@ -182,15 +235,23 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
 
                 pos.unmake_move(undo);
 
-                if (score >= ubound)
+                if (si.aborted)
+                    return 0;
+
+                if (score >= ubound) {
+                    STAT_INC(probcut_cuts);
                     return score;
+                }
             }
         }
     }
 
     MoveList quiets;
 
-    Order order(pos, history, node.tte.move, ply, depth);
+    Order order(pos, history, node.tt_move, ply, depth);
+
+    if (!ply && si.root_depth > 1)
+        order.sort_root(si.rmoves);
 
     UndoInfo undo = pos.undo_info();
 
@@ -202,6 +263,12 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
         if (!pos.move_is_legal(m))
             continue;
 
+        // MultiPV lines already reported in this iteration and moves left
+        // out by searchmoves are not counted, so the first move searched at
+        // the root gets a full window and no reduction
+        if (!ply && si.excluded(m))
+            continue;
+
         node.legals++;
 
         if (m == skip_move)
@@ -212,20 +279,22 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
         bool dangerous  = pos.checkers() || !quiet;
 
         if (node.best_score >= -4000 && order.score() < Order::ScoreCounter) {
-            if (ply && depth <= 8 && !dangerous && node.legals >= lmp_limit)
-                continue;
-
-            if (depth >= 8 && !dangerous && !pos.see(m, see_quiet))
-                continue;
-
-            if (depth <= 7 && !dangerous && !order.see())
+            if (ply && depth <= 8 && !dangerous && node.legals >= lmp_limit) {
+                STAT_INC(lmp);
                 continue;
+            }
 
-            if (depth >= 4 && !quiet && !pos.see(m, see_noisy))
+            if (   (depth >= 8 && !dangerous && !pos.see(m, see_quiet))
+                || (depth <= 7 && !dangerous && !order.see())) {
+                STAT_INC(see_quiet);
                 continue;
+            }
 
-            if (depth <= 3 && !quiet && !order.see())
+            if (   (depth >= 4 && !quiet && !pos.see(m, see_noisy))
+                || (depth <= 3 && !quiet && !order.see())) {
+                STAT_INC(see_noisy);
                 continue;
+            }
         }
 
         int next_depth = depth - 1;
@@ -237,10 +306,31 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
 
             int score = search(pos, lbound - 1, lbound, ply, (depth - 1) / 2, node.pv, m);
 
-            if (score < lbound)
+            if (si.aborted)
+                return 0;
+
+            STAT_INC(se_tries);
+
+            if (score < lbound) {
+                STAT_INC(se_extended);
                 next_depth++;
-            else if (lbound >= beta)
+            }
+            else if (lbound >= beta) {
+                STAT_INC(se_cutoff);
                 return lbound;
+            }
+
+            // Multi-cut: another move also beats beta at reduced depth
+            else if (SEMultiCut && score >= beta && score_is_eval(score)) {
+                STAT_INC(se_multicut);
+                return score;
+            }
+
+            // Negative extension: the TT move fails high but is not singular
+            else if (SENegExt && node.tte.score >= beta) {
+                STAT_INC(se_negative);
+                next_depth--;
+            }
         }
 
         int red;
@@ -261,6 +351,8 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
         if (!m.is_tactical())
             quiets.add(m);
 
+        i64 nodes = si.tnodes;
+
         pos.make_move(m);
 
         ttable.prefetch(pos.key());
@@ -268,18 +360,30 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
 
         int score, zws = (node.pv_node && node.legals > 1) || red;
 
-        if (zws)
+        if (zws) {
             score = -search(pos, -alfa - 1, -alfa, ply + 1, next_depth - red, node.pv);
 
+            STAT_ADD(lmr_searches, red > 0);
+            STAT_ADD(lmr_researches, red > 0 && score > alfa);
+        }
+
         if (!zws || score > alfa)
             score = -search(pos, -beta, -alfa, ply + 1, next_depth, node.pv);
 
         pos.unmake_move(undo);
 
+        if (!ply)
+            si.root_move(m)->nodes += si.tnodes - nodes;
+
+        // Unwind without touching the TT. At the root, si.update has already
+        // recorded any move of this iteration that beat the first one.
+        if (si.aborted)
+            return 0;
+
         if (score > node.best_score) {
             node.best_score = score;
 
-            if (!ply && node.legals == 1)
+            if (!ply && node.legals == 1 && !si.pv_index)
                 si.fail_low = node.best_score <= alfa;
 
             if (node.best_score > alfa) {
@@ -296,8 +400,11 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
                 }
 
                 if (alfa >= beta) {
+                    STAT_INC(fail_highs);
+                    STAT_ADD(fail_highs_first, node.legals == 1);
+
                     if (!skip_move && !node.best_move.is_tactical())
-                        history.update(pos, ply, depth, node.best_move, quiets);
+                        history.update(pos, ply, depth, node.best_move, quiets, order.threats());
 
                     break;
                 }
@@ -311,11 +418,17 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
     if (node.best_score <= -ScoreMate)
         return max(alfa, mated_in(ply + 1));
 
-    if (!skip_move) {
+    // Secondary MultiPV lines exclude moves, so their root results are not stored
+    if (!skip_move && !(!ply && si.pv_index)) {
         i16 eval = pos.checkers() ? -ScoreMate : Evals[ply];
         u8 bound = calc_bound(node.best_score, node.orig_alfa, beta);
 
         ttable.set(pos.key(), node.best_move, node.best_score, eval, depth, bound, ply);
+
+        if (ClusterShare && ply && depth >= ClusterShareDepth) {
+            cluster_offer(pos.key(), node.best_move, score_to_tt(node.best_score, ply), eval, depth, bound);
+            cluster_apply();
+        }
     }
 
     return node.best_score;
@@ -324,10 +437,13 @@ int search(Position& pos, int alfa, int beta, const int ply, const int depth, PV
 int qsearch(Position& pos, int alfa, const int beta, const int ply, const int depth, PV& pv, bool is_pv)
 {
     // Do we need to abort the search?
-    si.checkup();
+    if (si.checkup())
+        return 0;
 
     Node node(pos, alfa, beta);
 
+    STAT_INC(nodes[SearchStats::QS]);
+
     int adj_eval = -ScoreMate;
 
     if (is_pv) {
@@ -340,18 +456,35 @@ int qsearch(Position& pos, int alfa, const int beta, const int ply, const int de
         if (pos.draw())
             return ScoreDraw;
 
+        // upcoming repetition
+
+        if (alfa < ScoreDraw && pos.has_game_cycle(ply)) {
+            alfa = ScoreDraw;
+
+            if (alfa >= beta) return alfa;
+        }
+
         if (ply >= PliesMax)
             return pos.checkers() ? ScoreDraw : eval(pos);
     }
 
     node.tthit = ttable.get(node.tte, pos.key(), ply);
 
+    STAT_INC(tt_probes[SearchStats::QS]);
+    STAT_ADD(tt_hits[SearchStats::QS], node.tthit);
+
+    if (node.tthit)
+        node.tt_move = pos.decode(node.tte.move);
+
     if (node.tthit && node.tte.depth >= depth && !is_pv) {
         bool cut =  node.tte.bound == BoundExact
                 || (node.tte.bound == BoundLower && node.tte.score >= beta)
                 || (node.tte.bound == BoundUpper && node.tte.score <= alfa);
 
-        if (cut) return node.tte.score;
+        if (cut) {
+            STAT_INC(tt_cuts[SearchStats::QS]);
+            return node.tte.score;
+        }
     }
 
     if (pos.checkers())
@@ -388,7 +521,7 @@ int qsearch(Position& pos, int alfa, const int beta, const int ply, const int de
 
     size_t qevasions = 0;
 
-    Order order(pos, history, node.tte.move, ply, depth);
+    Order order(pos, history, node.tt_move, ply, depth);
 
     UndoInfo undo = pos.undo_info();
 
@@ -413,6 +546,9 @@ int qsearch(Position& pos, int alfa, const int beta, const int ply, const int de
 
         pos.unmake_move(undo);
 
+        if (si.aborted)
+            return 0;
+
         qevasions += !m.is_tactical() && pos.checkers();
 
         if (score > node.best_score) {
@@ -466,6 +602,9 @@ static int search_aspirate(Position pos, int depth, PV& pv, int score)
 
         score = search(pos, alfa, beta, 0, depth, pv);
 
+        if (si.aborted)
+            return score;
+
         if (score <= alfa) {
             beta = (alfa + beta) / 2;
             alfa = max(alfa - delta, -ScoreMate);
@@ -491,54 +630,131 @@ void search_iterate()
 
     gen_moves(moves, si.pos, GenMode::Legal);
 
-    si.singular = moves.size() == 1;
+    si.rmoves.clear();
 
-    PV pv;
+    for (Move m : moves) {
+        auto& sm = sl.searchmoves;
 
-    int score = 0;
+        if (sm.empty() || find(sm.begin(), sm.end(), m) != sm.end())
+            si.rmoves.emplace_back(m);
+    }
 
-    for (int depth = 1; depth <= DepthMax; depth++) {
+    // None of the searchmoves is legal
+    if (si.rmoves.empty()) {
+        sl.searchmoves.clear();
 
-        try {
-            score = search_aspirate(si.pos, depth, pv, score);
-        } catch (int i) {
-            break;
-        }
+        for (Move m : moves)
+            si.rmoves.emplace_back(m);
+    }
 
-        // Aspiration completed successfully without reaching time limit or node limit
+    si.singular = si.rmoves.size() == 1;
 
-        si.update(depth, score, pv);
+    si.multipv = min(MultiPV, int(si.rmoves.size()));
 
-        if (sl.depth && depth >= sl.depth)
-            break;
+    // The root moves are split among the worker processes instead
+    if (cluster_active()) {
+        cluster_iterate();
+        return;
+    }
 
-        if (sl.time_managed()) {
-            if (si.singular)
-                break;
+    PV pv;
 
-            double usage = si.time_usage(sl);
+    for (int depth = 1; depth <= DepthMax; depth++) {
 
-            if (usage >= 0.7 && !si.score_drop && si.bm_stable >= 10)
-                break;
+        for (si.pv_index = 0; si.pv_index < si.multipv; si.pv_index++) {
+            RootMove& rm = si.rmoves[si.pv_index];
 
-            if (usage >= 0.9 && !si.score_drop)
+            int score = search_aspirate(si.pos, depth, pv, depth > 1 ? rm.score : 0);
+
+            if (si.aborted)
                 break;
+
+            // Move the line's root move into place and record it
+
+            auto it = find_if(si.rmoves.begin() + si.pv_index, si.rmoves.end(),
+                              [&](const RootMove& r) { return r.move == pv[0]; });
+
+            if (it != si.rmoves.end()) {
+                rotate(si.rmoves.begin() + si.pv_index, it, it + 1);
+
+                si.rmoves[si.pv_index].score = score;
+
+                memcpy(si.rmoves[si.pv_index].pv, pv, sizeof(PV));
+            }
+
+            // Aspiration completed successfully without reaching time limit or node limit
+
+            si.update(depth, score, pv);
         }
+
+        // Spend less time when most of the effort went into the best move
+
+        if (!si.aborted && depth >= 6) {
+            double frac = double(si.rmoves[0].nodes) / max(si.tnodes, i64(1));
+
+            si.node_factor = clamp(2.0 * (1.0 - frac) + 0.4, 0.5, 1.5);
+        }
+
+        si.pv_index = 0;
+
+#ifdef SEARCH_STATS
+        if (!si.aborted)
+            sstats.iter_nodes.push_back(si.tnodes);
+#endif
+
+        if (!si.aborted && cluster_worker())
+            cluster_iteration(depth);
+
+        if (si.aborted || search_iteration_done(depth))
+            break;
     }
 
     ttable.age();
 }
 
+// Limits that are checked once an iteration is complete
+bool search_iteration_done(int depth)
+{
+    if (sl.depth && depth >= sl.depth)
+        return true;
+
+    if (sl.time_managed() && !Pondering) {
+        if (si.singular)
+            return true;
+
+        double usage = si.time_usage(sl);
+
+        if (usage >= 0.7 && !si.score_drop && si.bm_stable >= 10)
+            return true;
+
+        if (usage >= 0.9 && !si.score_drop)
+            return true;
+    }
+
+    return false;
+}
+
 void search_start()
 {
     Searching = true;
 
+#ifdef SEARCH_STATS
+    sstats = SearchStats();
+#endif
+
+    IIR                 = opt_list.get("IIR").check_value();
+    IIRDepthMin         = opt_list.get("IIRDepthMin").spin_value();
+
+    MultiPV             = opt_list.get("MultiPV").spin_value();
+
     NMPruning           = opt_list.get("NMPruning").check_value();
     NMPruningDepthMin   = opt_list.get("NMPruningDepthMin").spin_value();
 
     SingularExt         = opt_list.get("SingularExt").check_value();
     SEDepthMin          = opt_list.get("SEDepthMin").spin_value();
     SEDepthOffset       = opt_list.get("SEDepthOffset").spin_value();
+    SEMultiCut          = opt_list.get("SEMultiCut").check_value();
+    SENegExt            = opt_list.get("SENegExt").check_value();
 
     StaticNMP           = opt_list.get("StaticNMP").check_value();
     StaticNMPDepthMax   = opt_list.get("StaticNMPDepthMax").spin_value();
@@ -561,10 +777,32 @@ void search_start()
     else {
         gstats.stimer.start(true);
 
+        WatchdogDone = false;
+        PollRequest = false;
+
+        wworker.run(watchdog);
+
         search_iterate();
 
+        {
+            unique_lock<mutex> lock(WatchdogMutex);
+
+            // bestmove must wait for ponderhit or stop
+            ReleaseCond.wait(lock, [] { return !(Pondering || sl.infinite) || StopRequest; });
+
+            WatchdogDone = true;
+        }
+
+        WatchdogCond.notify_one();
+        wworker.wait();
+
         si.uci_bestmove();
 
+#ifdef SEARCH_STATS
+        for (const string& line : sstats.lines())
+            uci_send("info string %s", line.c_str());
+#endif
+
         gstats.stimer.stop(true);
         gstats.stimer.accrue(true);
     
@@ -599,13 +837,92 @@ void search_start()
     }
 }
 
+void search_stop()
+{
+    {
+        lock_guard<mutex> lock(WatchdogMutex);
+
+        StopRequest = true;
+    }
+
+    PollRequest = true;
+
+    ReleaseCond.notify_one();
+}
+
+// The time limits set by uci_go take effect, counting the time spent
+// pondering
+void search_ponderhit()
+{
+    {
+        lock_guard<mutex> lock(WatchdogMutex);
+
+        Pondering = false;
+    }
+
+    PollRequest = true;
+
+    WatchdogCond.notify_one();
+    ReleaseCond.notify_one();
+}
+
+// Sleeps until the next time limit or info report is due and asks the
+// search thread to check up on the clock
+void watchdog()
+{
+    unique_lock<mutex> lock(WatchdogMutex);
+
+    while (true) {
+        i64 dur  = si.timer.elapsed_time();
+        i64 next = watchdog_next(dur);
+
+        if (WatchdogCond.wait_for(lock, Timer::Milli(next), [] { return WatchdogDone; }))
+            break;
+
+        PollRequest.store(true, memory_order_relaxed);
+    }
+}
+
+i64 watchdog_next(i64 dur)
+{
+    // Periodic currmove reports start after five seconds
+    i64 next = dur < 5000 ? 5000 - dur : 1000 - (dur - 5000) % 1000;
+
+    if (Pondering)
+        return next;
+
+    if (sl.move_time)
+        next = min(next, sl.move_time - dur);
+
+    else if (sl.time_managed()) {
+        i64 otime = sl.opt_time;
+        i64 xtime = sl.max_time;
+
+        // Soft limits depend on the state of the search past half the
+        // optimal time, which node_factor may halve, so poll at a fraction
+        // of it from then on
+        if (4 * dur < otime)
+            next = min(next, otime / 4 - dur);
+        else
+            next = min(next, max(otime / 50, i64(1)));
+
+        next = min(next, xtime - dur);
+    }
+
+    return max(next, i64(1));
+}
+
 void search_reset()
 {
     memset(Evals, 0, sizeof(Evals));
 
     history.reset();
 
-    ttable.reset();
+    // A shared table holds the work of other processes, and GUIs send
+    // ucinewgame at startup and before every game
+    if (!ttable.shared())
+        ttable.reset();
+
     etable.reset();
 }
 
@@ -624,25 +941,21 @@ void SearchInfo::update(int depth, int score, PV& pv, bool complete)
     i64 dur = timer.elapsed_time(1);
 
     // Don't flood stdout if time limited
-    bool report = (depth > max_depth || pv[0] != best_move)
-               && (singular || !sl.time_limited() || depth >= 6 || dur >= 100);
-
-    if (report) {
-        ostringstream oss;
+    bool flood = !singular && sl.time_limited() && depth < 6 && dur < 100;
 
-        oss << "info" 
-            << " depth "    << depth
-            << " seldepth " << sel_depth
-            << " score "    << uci_score(score)
-            << " time "     << dur
-            << " nodes "    << tnodes
-            << " nps "      << 1000 * tnodes / dur
-            << " hashfull " << ttable.permille()
-            << " pv "       << pv_string(pv);
+    // Secondary MultiPV lines are only reported, once complete
+    if (pv_index) {
+        if (!flood && complete)
+            uci_pv(depth, score, pv, dur);
 
-        uci_send(oss.str().c_str());
+        return;
     }
 
+    bool report = (depth > max_depth || pv[0] != best_move || multipv > 1) && !flood;
+
+    if (report)
+        uci_pv(depth, score, pv, dur);
+
     max_depth = depth;
 
     if (pv[0] == best_move)
@@ -660,6 +973,50 @@ void SearchInfo::update(int depth, int score, PV& pv, bool complete)
     fail_low = false;
 
     best_move = pv[0];
+    ponder_move = pv[0] ? pv[1] : Move::None();
+}
+
+void SearchInfo::uci_pv(int depth, int score, PV& pv, i64 dur) const
+{
+    ostringstream oss;
+
+    oss << "info" 
+        << " depth "    << depth
+        << " seldepth " << sel_depth;
+
+    if (multipv > 1)
+        oss << " multipv " << pv_index + 1;
+
+    oss << " score "    << uci_score(score)
+        << " time "     << dur
+        << " nodes "    << tnodes
+        << " nps "      << 1000 * tnodes / dur
+        << " hashfull " << ttable.permille()
+        << " pv "       << pv_string(pv);
+
+    uci_send(oss.str().c_str());
+}
+
+bool SearchInfo::excluded(Move m) const
+{
+    for (int i = 0; i < pv_index; i++)
+        if (rmoves[i].move == m)
+            return true;
+
+    // Moves left out by go searchmoves
+    if (!sl.searchmoves.empty())
+        return none_of(rmoves.begin(), rmoves.end(), [&](const RootMove& rm) { return rm.move == m; });
+
+    return false;
+}
+
+RootMove * SearchInfo::root_move(Move m)
+{
+    for (RootMove& rm : rmoves)
+        if (rm.move == m)
+            return &rm;
+
+    return nullptr;
 }
 
 void SearchInfo::uci_bestmove() const
@@ -680,6 +1037,9 @@ void SearchInfo::uci_bestmove() const
 
     oss << "bestmove " << si.best_move.str();
 
+    if (ponder_move)
+        oss << " ponder " << ponder_move.str();
+
     uci_send(oss.str().c_str());
 }
 
@@ -701,46 +1061,39 @@ void SearchInfo::uci_info(i64 dur) const
 }
 
 // Depth limit is handled in search_iterate
-void SearchInfo::checkup()
+bool SearchInfo::checkup()
 {
-    if (--cnodes >= 0)
-        return;
+    if (aborted)
+        return true;
 
-    if (!best_move.is_valid())
-        return;
+    // Raised by the watchdog at deadlines and by stop requests
+    if (!PollRequest.load(memory_order_relaxed) && (!sl.nodes || tnodes < sl.nodes))
+        return false;
 
-    i64 cnodes_next = 100000;
-    i64 dur = timer.elapsed_time();
+    if (!best_move.is_valid())
+        return false;
 
-    bool abort = StopRequest.load(std::memory_order_relaxed);
+    PollRequest.store(false, memory_order_relaxed);
 
-    if (!abort && sl.nodes) {
-        i64 diff = tnodes - sl.nodes;
+    i64 dur = timer.elapsed_time();
 
-        cnodes_next = -diff / 2;
+    bool abort = StopRequest.load(memory_order_relaxed);
 
-        if (diff >= 0)
-            abort = true;
-    }
-
-    if (!abort && sl.time_limited()) {
-        i64 rem_time = 1000; // 1 second
+    if (!abort && sl.nodes && tnodes >= sl.nodes)
+        abort = true;
 
+    if (!abort && sl.time_limited() && !Pondering.load(memory_order_relaxed)) {
         if (sl.move_time) {
-            rem_time = sl.move_time - dur;
-
             if (dur >= sl.move_time)
                 abort = true;
         }
 
         else if (sl.time_managed()) {
-            i64 otime = sl.opt_time;
+            i64 otime = sl.opt_time * node_factor;
             i64 xtime = sl.max_time;
 
             double usage = dur / double(otime);
 
-            rem_time = (dur >= otime ? xtime : otime) - dur;
-
             // Maximum time threshold
             if (dur >= xtime)
                 abort = true;
@@ -770,16 +1123,10 @@ void SearchInfo::checkup()
                     abort = true;
             }
         }
-
-        i64 n = clamp(rem_time, i64(1), i64(1000)) * 100;
-
-        cnodes_next = min(cnodes_next, n);
     }
 
     if (abort)
-        throw 1;
-
-    cnodes = cnodes_next;
+        return aborted = true;
 
     if (max_depth >= 6) {
         if (dur > 5000 && dur - rep_time >= 1000) {
@@ -788,6 +1135,8 @@ void SearchInfo::checkup()
             uci_info(dur);
         }
     }
+
+    return false;
 }
 
 static string pv_string(PV& pv)
@@ -815,6 +1164,8 @@ u8 calc_bound(int score, int alfa, int beta)
 
 void search_init()
 {
+    wworker.init();
+
     for (int d = 1; d < 64; d++)
         for (int m = 1; m < 64; m++)
             LMReductions[d][m] = log2(d) * log2(m) * 0.4;
@@ -848,10 +1199,16 @@ int calc_reductions(const Node& node, int depth, Move m, Order& order, bool chec
 
         red -= clamp(score / (5 * 1024), -1, 1);
 
+        // Escaping a threatened square
+
+        u64 threats = order.threats();
+
+        red -= bb::test(threats, m.orig()) && !bb::test(threats, m.dest());
+
         if (checks)
             red -= 1 + node.pv_node;
 
-        red += node.tte.move.is_valid() && node.tte.move.is_tactical();
+        red += node.tt_move.is_valid() && node.tt_move.is_tactical();
         red += !order.see();
         red += !node.improving;
     }
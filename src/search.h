@@ -24,6 +24,8 @@ extern MoveStack mstack;
 
 extern std::atomic_bool Searching;
 extern std::atomic_bool StopRequest;
+extern std::atomic_bool PollRequest;
+extern std::atomic_bool Pondering;
 
 struct Node {
     const Position& pos;
@@ -41,6 +43,7 @@ struct Node {
 
     bool tthit;
     Entry tte;
+    Move tt_move = Move::None();
 
     Move best_move = Move::None();
     Move ext_move  = Move::None();
@@ -51,7 +54,7 @@ struct Node {
         pos(p),
         orig_alfa(alfa),
         pv_node(beta - alfa > 1),
-        tte(Move::None())
+        tte()
     {
     }
 };
@@ -70,16 +73,33 @@ struct SearchLimits {
 
     int movestogo   = 0;
 
+    // Root moves given by go searchmoves, empty for all
+    std::vector<Move> searchmoves;
+
     bool time_managed() const { return time || inc; }
     bool time_limited() const { return time || inc || move_time; }
 };
 
+struct RootMove {
+    Move move;
+
+    int score = -ScoreMate;
+
+    i64 nodes = 0;
+
+    PV pv = { };
+
+    RootMove(Move m) : move(m) { }
+};
+
 struct SearchInfo {
     Position pos;
 
     bool fail_low;
 
-    i64 cnodes;
+    // Set once the search must unwind
+    bool aborted;
+
     i64 tnodes;
 
     i64 rep_time;
@@ -98,7 +118,17 @@ struct SearchInfo {
 
     bool singular;
 
+    // Scales the optimal time by the best move's share of nodes
+    double node_factor;
+
+    // MultiPV
+    int multipv;
+    int pv_index;
+
+    std::vector<RootMove> rmoves;
+
     Move best_move;
+    Move ponder_move;
     Move curr_move;
 
     Timer timer;
@@ -110,19 +140,24 @@ struct SearchInfo {
 
     double time_usage(const SearchLimits &sl) const
     {
-        return double(timer.elapsed_time()) / sl.opt_time;
+        return double(timer.elapsed_time()) / (sl.opt_time * node_factor);
     }
 
+    void uci_pv(int depth, int score, PV& pv, i64 dur) const;
     void uci_info(i64 dur) const;
     void uci_bestmove() const;
 
-    void checkup();
+    bool checkup();
+
+    bool excluded(Move m) const;
+    RootMove * root_move(Move m);
 
     void reset()
     {
         fail_low        = false;
 
-        cnodes          = 0;
+        aborted         = false;
+
         tnodes          = 0;
 
         rep_time        = 0;
@@ -141,7 +176,15 @@ struct SearchInfo {
 
         singular        = false;
 
+        node_factor     = 1.0;
+
+        multipv         = 1;
+        pv_index        = 0;
+
+        rmoves.clear();
+
         best_move       = Move::None();
+        ponder_move     = Move::None();
         curr_move       = Move::None();
 
         timer           = Timer();
@@ -154,6 +197,10 @@ extern SearchLimits sl;
 void search_init();
 void search_reset();
 void search_start();
+void search_stop();
+void search_ponderhit();
+
+bool search_iteration_done(int depth);
 
 constexpr int mate_in(int ply) { return ScoreMate - ply; }
 constexpr int mated_in(int ply) { return ply - ScoreMate; }
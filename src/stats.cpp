@@ -0,0 +1,101 @@
+#include "stats.h"
+
+#ifdef SEARCH_STATS
+
+#include <algorithm>
+#include <format>
+#include <string>
+#include <vector>
+using namespace std;
+
+SearchStats sstats;
+
+static double percent(i64 n, i64 total)
+{
+    return total ? 100.0 * n / total : 0.0;
+}
+
+SearchStats& SearchStats::operator+=(const SearchStats& s)
+{
+    for (int t = 0; t < NodeTypes; t++) {
+        nodes[t]     += s.nodes[t];
+        tt_probes[t] += s.tt_probes[t];
+        tt_hits[t]   += s.tt_hits[t];
+        tt_cuts[t]   += s.tt_cuts[t];
+    }
+
+    fail_highs       += s.fail_highs;
+    fail_highs_first += s.fail_highs_first;
+
+    nmp_tries        += s.nmp_tries;
+    nmp_cuts         += s.nmp_cuts;
+    static_nmp       += s.static_nmp;
+    probcut_tries    += s.probcut_tries;
+    probcut_cuts     += s.probcut_cuts;
+
+    lmp              += s.lmp;
+    see_quiet        += s.see_quiet;
+    see_noisy        += s.see_noisy;
+
+    lmr_searches     += s.lmr_searches;
+    lmr_researches   += s.lmr_researches;
+
+    se_tries         += s.se_tries;
+    se_extended      += s.se_extended;
+    se_cutoff        += s.se_cutoff;
+    se_multicut      += s.se_multicut;
+    se_negative      += s.se_negative;
+
+    // Summed per depth, so the branching factor is that of the totals
+    if (iter_nodes.size() < s.iter_nodes.size())
+        iter_nodes.resize(s.iter_nodes.size());
+
+    for (size_t i = 0; i < s.iter_nodes.size(); i++)
+        iter_nodes[i] += s.iter_nodes[i];
+
+    return *this;
+}
+
+vector<string> SearchStats::lines() const
+{
+    vector<string> v;
+
+    i64 total = nodes[NonPV] + nodes[PV] + nodes[QS];
+
+    v.push_back(format("nodes pv {} nonpv {} qs {} qs share {:.1f}%",
+                       nodes[PV], nodes[NonPV], nodes[QS], percent(nodes[QS], total)));
+
+    const char * names[NodeTypes] = { "nonpv", "pv", "qs" };
+
+    for (int t : { PV, NonPV, QS })
+        v.push_back(format("tt {} probes {} hits {:.1f}% cuts {:.1f}%", names[t],
+                           tt_probes[t], percent(tt_hits[t], tt_probes[t]), percent(tt_cuts[t], tt_probes[t])));
+
+    v.push_back(format("fail high {} first move {:.1f}%", fail_highs, percent(fail_highs_first, fail_highs)));
+
+    v.push_back(format("nmp tries {} cuts {:.1f}% static nmp {} probcut tries {} cuts {:.1f}%",
+                       nmp_tries, percent(nmp_cuts, nmp_tries), static_nmp,
+                       probcut_tries, percent(probcut_cuts, probcut_tries)));
+
+    v.push_back(format("pruned lmp {} see quiet {} see noisy {}", lmp, see_quiet, see_noisy));
+
+    v.push_back(format("lmr searches {} re-searches {:.1f}%", lmr_searches, percent(lmr_researches, lmr_searches)));
+
+    v.push_back(format("singular tries {} extended {} cutoff {} multicut {} negative {}",
+                       se_tries, se_extended, se_cutoff, se_multicut, se_negative));
+
+    string ebf = "ebf";
+
+    for (size_t i = 1; i < iter_nodes.size(); i++) {
+        i64 prev = iter_nodes[i - 1] - (i >= 2 ? iter_nodes[i - 2] : 0);
+        i64 curr = iter_nodes[i] - iter_nodes[i - 1];
+
+        ebf += format(" {}:{:.2f}", i + 1, prev > 0 ? double(curr) / prev : 0.0);
+    }
+
+    v.push_back(ebf);
+
+    return v;
+}
+
+#endif
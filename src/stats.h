@@ -0,0 +1,66 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Search statistics, only compiled in with -DSEARCH_STATS (make STATS=yes).
+// Otherwise the macros expand to nothing and their arguments are not
+// evaluated.
+
+#ifdef SEARCH_STATS
+
+#include <string>
+#include <vector>
+#include "misc.h"
+
+struct SearchStats {
+    // Node types, PV indexed by Node::pv_node
+    enum { NonPV, PV, QS, NodeTypes };
+
+    i64 nodes[NodeTypes]        = { };
+
+    i64 tt_probes[NodeTypes]    = { };
+    i64 tt_hits[NodeTypes]      = { };
+    i64 tt_cuts[NodeTypes]      = { };
+
+    i64 fail_highs              = 0;
+    i64 fail_highs_first        = 0;
+
+    i64 nmp_tries               = 0;
+    i64 nmp_cuts                = 0;
+    i64 static_nmp              = 0;
+    i64 probcut_tries           = 0;
+    i64 probcut_cuts            = 0;
+
+    i64 lmp                     = 0;
+    i64 see_quiet               = 0;
+    i64 see_noisy               = 0;
+
+    i64 lmr_searches            = 0;
+    i64 lmr_researches          = 0;
+
+    i64 se_tries                = 0;
+    i64 se_extended             = 0;
+    i64 se_cutoff               = 0;
+    i64 se_multicut             = 0;
+    i64 se_negative             = 0;
+
+    // Total nodes at the end of each completed iteration
+    std::vector<i64> iter_nodes;
+
+    SearchStats& operator+=(const SearchStats& s);
+
+    std::vector<std::string> lines() const;
+};
+
+extern SearchStats sstats;
+
+#define STAT_INC(counter)       (sstats.counter++)
+#define STAT_ADD(counter, n)    (sstats.counter += (n))
+
+#else
+
+#define STAT_INC(counter)       ((void)0)
+#define STAT_ADD(counter, n)    ((void)0)
+
+#endif
+
+#endif
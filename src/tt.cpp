@@ -1,5 +1,12 @@
-#include <bit>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <utility>
+#include <vector>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "mem.h"
 #include "search.h"
 #include "tt.h"
 
@@ -7,6 +14,68 @@ using namespace std;
 
 TT ttable(TTSizeMBDefault);
 
+// Bump TTFileVersion whenever Entry or the key to slot mapping changes
+
+constexpr char TTFileMagic[8] = "CadieTT";
+constexpr u32  TTFileVersion  = 2;
+
+struct TTFileHeader {
+    char magic[8];
+    u32 version;
+    u32 entry_size;
+    u64 count;
+    u8 gen;
+    u8 epoch;
+    u8 pad[38];
+};
+
+static_assert(sizeof(TTFileHeader) == 64);
+
+static TTFileHeader make_header(u64 count, u8 gen, u8 epoch)
+{
+    TTFileHeader header = {};
+
+    memcpy(header.magic, TTFileMagic, sizeof(header.magic));
+
+    header.version    = TTFileVersion;
+    header.entry_size = sizeof(Entry);
+    header.count      = count;
+    header.gen        = gen;
+    header.epoch      = epoch;
+
+    return header;
+}
+
+static bool header_is_valid(const TTFileHeader * header, size_t bytes)
+{
+    return bytes >= sizeof(TTFileHeader)
+        && memcmp(header->magic, TTFileMagic, sizeof(header->magic)) == 0
+        && header->version == TTFileVersion
+        && header->entry_size == sizeof(Entry)
+        && header->count > 0
+        && header->epoch != 0
+        && bytes == sizeof(TTFileHeader) + header->count * sizeof(Entry);
+}
+
+// Entries are stored with their first word (lock and move) XOR-ed with the
+// second. A slot torn by two processes writing a shared table at once then
+// fails the lock check instead of returning a mix of two entries.
+
+static Entry scramble(const Entry& e)
+{
+    u64 words[2];
+
+    memcpy(words, &e, sizeof(words));
+
+    words[0] ^= words[1];
+
+    Entry r;
+
+    memcpy(&r, words, sizeof(r));
+
+    return r;
+}
+
 int score_to_tt(int score, int ply)
 {
     if (score >= mate_in(PliesMax))
@@ -29,26 +98,255 @@ int score_from_tt(int score, int ply)
 
 TT::TT(size_t mb)
 {
-    size_  = bit_floor(mb * 1024 * 1024);
+    size_  = mb * 1024 * 1024;
     count_ = size_ / sizeof(Entry);
-    mask_  = count_ - 1;
+}
+
+TT::~TT()
+{
+    release();
+}
+
+TT& TT::operator=(TT&& tt)
+{
+    if (this == &tt)
+        return *this;
+
+    release();
+
+    entries_  = exchange(tt.entries_, nullptr);
+    map_      = exchange(tt.map_, nullptr);
+    map_size_ = tt.map_size_;
+    shared_   = tt.shared_;
+    count_    = tt.count_;
+    size_     = tt.size_;
+    gen_      = tt.gen_;
+    epoch_    = tt.epoch_;
+    hits_     = tt.hits_;
+    gets_     = tt.gets_;
+
+    gen_ptr_   = shared_ ? tt.gen_ptr_   : &gen_;
+    epoch_ptr_ = shared_ ? tt.epoch_ptr_ : &epoch_;
+
+    tt.shared_    = false;
+    tt.gen_ptr_   = &tt.gen_;
+    tt.epoch_ptr_ = &tt.epoch_;
+
+    return *this;
 }
 
 void TT::init()
 {
-    entries_.resize(count_);
+    release();
+
+    entries_ = static_cast<Entry *>(mem::alloc(size_));
+
+    mem::clear(entries_, size_);
+
+    epoch_ = 1;
+}
+
+// Entries from an older epoch count as empty, so clearing only needs a
+// physical wipe when the epoch counter wraps around. Clearing a shared
+// table clears it for every attached process, so only Clear Hash does
+// that; search_reset leaves a shared table alone.
+
+void TT::reset()
+{
+    hits_ = 0;
+    gets_ = 0;
+
+    // Other processes keep aging a shared table
+    if (!shared_)
+        gen_ = 0;
+
+    u8 e = atomic_ref<u8>(*epoch_ptr_).fetch_add(1, memory_order_relaxed) + 1;
+
+    if (e == 0) {
+        mem::clear(entries_, size_);
+        atomic_ref<u8>(*epoch_ptr_).store(1, memory_order_relaxed);
+    }
+}
+
+// The smallest key that maps onto slot i of a table with count entries
+
+static u64 first_key(u64 count, u64 i)
+{
+    return u64(((u128(i) << 64) + count - 1) / count);
+}
+
+// Rehashes the entries into a table of the new size. Every slot spans at
+// most 2^48 keys (TTSizeMBMin is 2^16 entries), so the full key follows
+// from the slot index and the 48-bit lock.
+
+void TT::resize(size_t mb)
+{
+    if (!entries_) {
+        size_  = mb * 1024 * 1024;
+        count_ = size_ / sizeof(Entry);
+
+        init();
+        return;
+    }
+
+    TT tt(mb);
+
+    tt.init();
+
+    tt.gen_   = gen();
+    tt.epoch_ = epoch();
+
+    size_t threads = max(1u, thread::hardware_concurrency());
+
+    threads = min(threads, max(size_, tt.size_) / (64 * 1024 * 1024) + 1);
+
+    vector<thread> workers;
+
+    // Each thread owns a range of new slots, so no two threads write to the
+    // same entry
+
+    for (size_t i = 0; i < threads; i++) {
+        u64 begin = tt.count_ *  i      / threads;
+        u64 end   = tt.count_ * (i + 1) / threads;
+
+        workers.emplace_back([this, &tt, begin, end]() { rehash(tt, begin, end); });
+    }
+
+    for (thread& t : workers)
+        t.join();
+
+    *this = std::move(tt);
+}
+
+// Moves the entries that map onto new slots [begin, end) into tt. On
+// collisions, entries from a newer search win, then deeper ones.
+
+void TT::rehash(TT& tt, u64 begin, u64 end) const
+{
+    constexpr u64 LockMask = Entry::make_lock(~0ull);
+
+    u64 first = index(first_key(tt.count_, begin));
+    u64 last  = end < tt.count_ ? index(first_key(tt.count_, end)) : count_ - 1;
+
+    for (u64 i = first; i <= last; i++) {
+        Entry src = scramble(entries_[i]);
+
+        if (src.epoch != epoch())
+            continue;
+
+        u64 lo  = first_key(count_, i);
+        u64 key = (lo & ~LockMask) | src.lock;
+
+        if (key < lo)
+            key += LockMask + 1;
+
+        if (index(key) != i)
+            continue;
+
+        u64 j = tt.index(key);
+
+        if (j < begin || j >= end)
+            continue;
+
+        Entry dst = scramble(tt.entries_[j]);
+
+        if (dst.epoch == epoch()) {
+            u8 src_age = gen() - src.gen;
+            u8 dst_age = gen() - dst.gen;
+
+            if (src_age > dst_age || (src_age == dst_age && src.depth <= dst.depth))
+                continue;
+        }
+
+        tt.entries_[j] = entries_[i];
+    }
+}
+
+void TT::release()
+{
+    if (map_)
+        mem::unmap(map_, map_size_);
+    else if (entries_)
+        mem::free(entries_);
+
+    entries_  = nullptr;
+    map_      = nullptr;
+    map_size_ = 0;
+    shared_   = false;
+
+    gen_ptr_   = &gen_;
+    epoch_ptr_ = &epoch_;
+}
+
+// Writes through a temporary file, since the target may be the file that
+// is currently mapped
+
+bool TT::save(const string& filename) const
+{
+    TTFileHeader header = make_header(count_, gen(), epoch());
+
+    string tmpname = filename + ".tmp";
+
+    {
+        ofstream ofs(tmpname, ios::binary);
+
+        ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char *>(entries_), count_ * sizeof(Entry));
+
+        if (!ofs.flush()) {
+            remove(tmpname.c_str());
+            return false;
+        }
+    }
+
+    return rename(tmpname.c_str(), filename.c_str()) == 0;
+}
+
+// Maps the file instead of reading it, so the restore itself is instant
+// and entries are paged in as the search touches them
+
+bool TT::load(const string& filename)
+{
+    size_t bytes = 0;
+
+    void * p = mem::map(filename, bytes);
+
+    if (!p)
+        return false;
+
+    const TTFileHeader * header = static_cast<const TTFileHeader *>(p);
+
+    if (!header_is_valid(header, bytes)) {
+        mem::unmap(p, bytes);
+        return false;
+    }
+
+    release();
+
+    count_ = header->count;
+    size_  = count_ * sizeof(Entry);
+    gen_   = header->gen;
+    epoch_ = header->epoch;
+    hits_  = 0;
+    gets_  = 0;
+
+    map_      = p;
+    map_size_ = bytes;
+    entries_  = reinterpret_cast<Entry *>(static_cast<u8 *>(p) + sizeof(TTFileHeader));
+
+    return true;
 }
 
 bool TT::get(Entry& dst, u64 key, int ply)
 {
     gets_++;
 
-    const Entry& src = entries_[key & mask_];
+    Entry src = scramble(entries_[index(key)]);
 
     Entry::Lock lock = Entry::make_lock(key);
 
-    // The non-zero bound check prevents collisions with uninitialized entries
-    if (src.lock == lock && src.bound) {
+    // The epoch check skips entries left over from before the last reset
+    if (src.lock == lock && src.epoch == epoch()) {
         hits_++;
 
         dst.move  = src.move;
@@ -65,24 +363,95 @@ bool TT::get(Entry& dst, u64 key, int ply)
 
 void TT::set(u64 key, Move m, i16 score, i16 eval, i8 depth, u8 bound, int ply)
 {
-    Entry * dst = &entries_[key & mask_];
+    Entry& slot = entries_[index(key)];
+
+    Entry dst = scramble(slot);
 
     Entry::Lock lock = Entry::make_lock(key);
 
-    bool write = (dst->lock == 0)
+    u8 g = gen();
+    u8 e = epoch();
+
+    bool stale = dst.epoch != e;
+
+    bool write = stale
               || (bound == BoundExact)
-              || (dst->gen != gen_)
-              || (dst->bound != BoundExact && depth >= dst->depth)
-              || (dst->lock == lock && depth + 3 > dst->depth);
+              || (dst.gen != g)
+              || (dst.bound != BoundExact && depth >= dst.depth)
+              || (dst.lock == lock && depth + 3 > dst.depth);
 
     if (write) {
-        if (m || dst->lock != lock) dst->move = m;
-
-        dst->lock   = lock;
-        dst->score  = score_to_tt(score, ply);
-        dst->eval   = eval;
-        dst->depth  = depth;
-        dst->gen    = gen_;
-        dst->bound  = bound;
+        if (m || stale || dst.lock != lock) dst.move = m.encode();
+
+        dst.lock   = lock;
+        dst.score  = score_to_tt(score, ply);
+        dst.eval   = eval;
+        dst.depth  = depth;
+        dst.gen    = g;
+        dst.bound  = bound;
+        dst.epoch  = e;
+
+        slot = scramble(dst);
+    }
+}
+
+// Places the table in a named POSIX shared memory segment, or attaches to
+// it if another process created it already. The segment outlives the
+// process, so a later process with the same name finds the entries again.
+// A process that attaches while another is still creating the segment sees
+// it empty or with a zero epoch, so it retries for up to a second; the
+// creator publishes the epoch last.
+
+bool TT::share(const string& name)
+{
+    constexpr int ShareTries = 100;
+
+    for (int i = 0; i < ShareTries; i++) {
+        if (i) this_thread::sleep_for(chrono::milliseconds(10));
+
+        size_t bytes = sizeof(TTFileHeader) + count_ * sizeof(Entry);
+
+        bool created = false;
+
+        void * p = mem::map_shared(name, bytes, created);
+
+        if (!p)
+            continue;
+
+        TTFileHeader * header = static_cast<TTFileHeader *>(p);
+
+        if (created) {
+            *header = make_header(count_, 0, 0);
+            atomic_ref<u8>(header->epoch).store(1, memory_order_release);
+        }
+
+        else if (atomic_ref<u8>(header->epoch).load(memory_order_acquire) == 0) {
+            mem::unmap(p, bytes);
+            continue;
+        }
+
+        else if (!header_is_valid(header, bytes)) {
+            mem::unmap(p, bytes);
+            return false;
+        }
+
+        release();
+
+        count_  = header->count;
+        size_   = count_ * sizeof(Entry);
+        hits_   = 0;
+        gets_   = 0;
+        shared_ = true;
+
+        gen_ptr_   = &header->gen;
+        epoch_ptr_ = &header->epoch;
+
+        map_      = p;
+        map_size_ = bytes;
+        entries_  = reinterpret_cast<Entry *>(static_cast<u8 *>(p) + sizeof(TTFileHeader));
+
+        return true;
     }
+
+    return false;
 }
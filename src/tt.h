@@ -2,9 +2,8 @@
 #define TT_H
 
 #include <algorithm>
-#include <bit>
-#include <vector>
-#include <cstring>
+#include <atomic>
+#include <string>
 #include "eval.h"
 #include "mem.h"
 #include "misc.h"
@@ -22,29 +21,32 @@ constexpr std::size_t TTSizeMBMax     = 128 * 1024; // 128 GB
 int score_to_tt(int score, int ply);
 int score_from_tt(int score, int ply);
 
+// Moves are stored in their 16-bit form, which leaves room for a 48-bit
+// lock within the same 16 bytes
+
 struct Entry {
-    using Lock = u32;
+    using Lock = u64;
 
-    static constexpr std::size_t LockBits = sizeof(Lock) * 8;
+    static constexpr std::size_t LockBits = 48;
 
-    Lock lock;
-    Move move;
+    Lock lock : LockBits;
+    Lock move : 16;
     i16 score;
     i16 eval;
     i8 depth;
     u8 gen;
     u8 bound;
-    u8 pad;
+    u8 epoch;
     
+    // The high key bits select the slot, so the lock comes from the low bits
+
     static constexpr Lock make_lock(u64 key)
     {
-        return static_cast<Lock>(key >> (64 - LockBits));
+        return key & ((Lock(1) << LockBits) - 1);
     }
 
     bool is_valid() const
     {
-        if (move != Move::None() && !move.is_valid())
-            return false;
         if (abs(score) > ScoreMate)
             return false;
         if (depth > DepthMax)
@@ -56,51 +58,55 @@ struct Entry {
     }
 
     constexpr Entry() = default;
-    constexpr Entry(Move m) : move(m) { }
 };
 
+static_assert(sizeof(Entry) == 16);
+
 class TT {
 public:
 
     TT(std::size_t mb);
+    ~TT();
+
+    TT(const TT&) = delete;
+    TT& operator=(TT&& tt);
 
     void init();
+    void resize(std::size_t mb);
+
+    bool save(const std::string& filename) const;
+    bool load(const std::string& filename);
+    bool share(const std::string& name);
+
+    bool shared() const { return shared_; }
 
     bool get(Entry& dst, u64 key, int ply);
     void set(u64 key, Move m, i16 score, i16 eval, i8 depth, u8 bound, int ply);
 
     std::size_t count() const { return count_; }
 
-    void reset()
-    {
-        gen_  = 0;
-        hits_ = 0;
-        gets_ = 0;
-
-        std::memset((void *)entries_.data(), 0, size_);
-    }
+    void reset();
 
     void age()
     {
-        gen_++;
+        std::atomic_ref<u8>(*gen_ptr_).fetch_add(1, std::memory_order_relaxed);
     }
 
     std::size_t permille() const
     {
         std::size_t pm = 0;
 
-        for (std::size_t i = 0; i < 1000; i++) {
-            const Entry& e = entries_[i];
+        u8 e = epoch();
 
-            pm += e.lock != 0;
-        }
+        for (std::size_t i = 0; i < 1000; i++)
+            pm += entries_[i].epoch == e;
 
         return pm;
     }
 
     void prefetch(u64 key)
     {
-        mem::prefetch(&entries_[key & mask_]);
+        mem::prefetch(&entries_[index(key)]);
     }
 
     std::size_t size_mb() const { return size_ / 1024 / 1024; }
@@ -108,14 +114,45 @@ public:
     std::size_t hitrate() const { return gets_ ? 100 * hits_ / gets_ : 0; }
 
 private:
-    std::vector<Entry> entries_;
+    // Maps the key onto [0, count_) with a fixed-point multiply, which
+    // allows table sizes that are not a power of two
+
+    std::size_t index(u64 key) const
+    {
+        return (u128(key) * count_) >> 64;
+    }
+
+    // A shared table keeps its generation and epoch in the segment header,
+    // so that all attached processes age and clear it together
+
+    u8 gen() const
+    {
+        return std::atomic_ref<u8>(*gen_ptr_).load(std::memory_order_relaxed);
+    }
+
+    u8 epoch() const
+    {
+        return std::atomic_ref<u8>(*epoch_ptr_).load(std::memory_order_relaxed);
+    }
+
+    void release();
+    void rehash(TT& tt, u64 begin, u64 end) const;
+
+    Entry * entries_ = nullptr;
+
+    // Set when the entries live in a file or shared memory mapping
+    void * map_           = nullptr;
+    std::size_t map_size_ = 0;
+    bool shared_          = false;
 
     u64 count_;
-    u64 mask_;
 
-    u8  gen_  = 0;
-    u64 hits_ = 0;
-    u64 gets_ = 0;
+    u8  gen_   = 0;
+    u8  epoch_ = 1;
+    u8 * gen_ptr_   = &gen_;
+    u8 * epoch_ptr_ = &epoch_;
+    u64 hits_  = 0;
+    u64 gets_  = 0;
     
     std::size_t size_;
 };
@@ -10,19 +10,27 @@
 #include <cinttypes>
 #include <cmath>
 #include <cstdarg>
+#include "cluster.h"
 #include "search.h"
 #include "string.h"
 #include "timer.h"
 #include "tt.h"
 #include "uci.h"
 #include "uciopt.h"
+#include "worker.h"
 using namespace std;
 
 fstream logfile;
 
 GlobalStats gstats;
 
-std::thread sthread;
+// Parked between searches
+Worker sworker;
+
+// Options set during a search, applied once it is done
+static vector<string> opt_queue;
+
+static mutex send_mutex;
 
 enum class Direction { In, Out };
 
@@ -38,17 +46,30 @@ static string uci_log_filename();
 
 // UCI options with default values
 
+string HashFile         = "cadie.hash";
+string HashShared       = "";
+
+bool IIR               =  true;
+int  IIRDepthMin        =     4;
+
+int  MultiPV            =     1;
+
 bool NMPruning          =  true;
 int  NMPruningDepthMin  =     2;
 
 bool SingularExt        =  true;
 int  SEDepthMin         =     6;
 int  SEDepthOffset      =     3;
+bool SEMultiCut         =  true;
+bool SENegExt           =  true;
 
 bool StaticNMP          =  true;
 int  StaticNMPDepthMax  =     7;
 int  StaticNMPFactor    =   100;
 
+int  CPUAffinity        =    -1;
+bool Ponder             = false;
+
 int  UciOverhead        =    10;
 bool UciLog             = false;
 
@@ -60,6 +81,15 @@ void uci_init()
 
     opt_list.add(UCIOption("Hash", TTSizeMBMin, ttable.size_mb(), TTSizeMBMax));
     opt_list.add(UCIOption("Clear Hash"));
+    opt_list.add(UCIOption("HashFile", HashFile));
+    opt_list.add(UCIOption("HashShared", HashShared));
+    opt_list.add(UCIOption("SaveHash"));
+    opt_list.add(UCIOption("LoadHash"));
+
+    opt_list.add(UCIOption("MultiPV", 1, MultiPV, 64));
+
+    opt_list.add(UCIOption("IIR", IIR));
+    opt_list.add(UCIOption("IIRDepthMin", 2, IIRDepthMin, 12));
 
     opt_list.add(UCIOption("NMPruning", NMPruning));
     opt_list.add(UCIOption("NMPruningDepthMin", 1, NMPruningDepthMin, 4));
@@ -67,16 +97,23 @@ void uci_init()
     opt_list.add(UCIOption("SingularExt", SingularExt));
     opt_list.add(UCIOption("SEDepthMin", 3, SEDepthMin, 7));
     opt_list.add(UCIOption("SEDepthOffset", 2, SEDepthOffset, 6));
+    opt_list.add(UCIOption("SEMultiCut", SEMultiCut));
+    opt_list.add(UCIOption("SENegExt", SENegExt));
 
     opt_list.add(UCIOption("StaticNMP", StaticNMP));
     opt_list.add(UCIOption("StaticNMPDepthMax", 1, StaticNMPDepthMax, 10));
     opt_list.add(UCIOption("StaticNMPFactor", 1, StaticNMPFactor, 500));
 
+    opt_list.add(UCIOption("CPUAffinity", -1, CPUAffinity, 1023));
+    opt_list.add(UCIOption("Ponder", Ponder));
+
     opt_list.add(UCIOption("UciOverhead", 1, UciOverhead, 2000));
     opt_list.add(UCIOption("UciLog", UciLog));
 
     if (UciLog)
         logfile.open(uci_log_filename(), ios::out | ios::app);
+
+    sworker.init();
 }
 
 void uci_loop()
@@ -106,18 +143,26 @@ void uci_loop()
             uci_go(line);
         }
 
-        else if (token == "isready") {
-            uci_stop();
+        // Answered without disturbing a search
+        else if (token == "isready")
             uci_send("readyok");
-        }
         
+        else if (token == "ponderhit")
+            search_ponderhit();
+
         else if (token == "position") {
             uci_stop();
             uci_position(line);
         }
 
-        else if (token == "setoption")
-            uci_setoption(line);
+        else if (token == "setoption") {
+            if (sworker.busy())
+                opt_queue.push_back(line);
+            else {
+                uci_stop();
+                uci_setoption(line);
+            }
+        }
 
         else if (token == "stop")
             uci_stop();
@@ -130,6 +175,10 @@ void uci_loop()
             uci_ucinewgame();
         }
         
+        // TT entries from other cluster workers
+        else if (token == "tt" && cluster_worker())
+            cluster_receive(line);
+
         else if (token == "quit")
             break;
 
@@ -149,6 +198,8 @@ void uci_go(const string& s)
     i64 time[2] = { };
     i64 inc[2] = { };
 
+    bool ponder = false;
+
     for (size_t i = 1; i < fields.size(); i++) {
         string token = fields[i];
 
@@ -170,6 +221,12 @@ void uci_go(const string& s)
             sl.move_time = stoll(fields[++i]);
         else if (token == "infinite")
             sl.infinite = true;
+        else if (token == "ponder")
+            ponder = true;
+        else if (token == "searchmoves") {
+            while (i + 1 < fields.size() && fields[i + 1].size() >= 4 && isdigit(fields[i + 1][1]))
+                sl.searchmoves.push_back(si.pos.note_move(fields[++i]));
+        }
     }
 
     sl.time = time[si.pos.side()];
@@ -200,7 +257,10 @@ void uci_go(const string& s)
     si.reset();
     si.timer.start();
 
-    sthread = thread(search_start);
+    Searching = true;
+    Pondering = ponder;
+
+    sworker.run(search_start);
 }
 
 void uci_send(const char format[], ...)
@@ -212,6 +272,9 @@ void uci_send(const char format[], ...)
     vsprintf(buf, format, arg_list);
     va_end(arg_list);
 
+    // Both the UCI and search threads send
+    lock_guard<mutex> lock(send_mutex);
+
     fprintf(stdout, "%s\n", buf);
 
     if (UciLog)
@@ -240,6 +303,8 @@ string uci_score(int score)
 
 void uci_position(const string& s)
 {
+    cluster_forward(s);
+
     Tokenizer fields(s);
 
     string fen;
@@ -281,6 +346,8 @@ void uci_position(const string& s)
 
 void uci_setoption(const string& s)
 {
+    cluster_forward(s);
+
     Tokenizer fields(s);
 
     string name = fields[2];
@@ -298,21 +365,64 @@ void uci_setoption(const string& s)
         return;
     }
 
-    if (i < fields.size() && fields[i] == "value")
+    if (i + 1 < fields.size() && fields[i] == "value")
         value = fields[i + 1];
 
     UCIOption& opt = opt_list.get(name);
 
     if (opt.get_type() == UCIOption::Button) {
+        string filename = opt_list.get("HashFile").string_value();
+
         if (name == "Clear Hash")
             ttable.reset();
+
+        else if (name == "SaveHash") {
+            if (!ttable.save(filename))
+                uci_send("info string could not save hash to %s", filename.c_str());
+        }
+
+        else if (name == "LoadHash") {
+            if (ttable.load(filename))
+                opt_list.get("Hash").set_value(to_string(ttable.size_mb()));
+            else
+                uci_send("info string could not load hash from %s", filename.c_str());
+        }
     }
     else {
         opt.set_value(value);
 
         if (name == "Hash") {
-            ttable = TT(opt.spin_value());
-            ttable.init();
+            if (ttable.shared()) {
+                uci_send("info string shared hash keeps its size of %zu MB", ttable.size_mb());
+                return;
+            }
+
+            Timer timer(true);
+
+            ttable.resize(opt.spin_value());
+
+            uci_send("info string hash resized to %zu MB in %lld ms", ttable.size_mb(), (long long)timer.elapsed_time());
+        }
+        else if (name == "HashShared") {
+            HashShared = opt.string_value() == "<empty>" ? "" : opt.string_value();
+
+            // An empty name returns to a private table
+
+            if (HashShared.empty()) {
+                if (ttable.shared()) {
+                    ttable = TT(opt_list.get("Hash").spin_value());
+                    ttable.init();
+                }
+            }
+            else if (ttable.share(HashShared))
+                opt_list.get("Hash").set_value(to_string(ttable.size_mb()));
+            else
+                uci_send("info string could not share hash as %s", HashShared.c_str());
+        }
+        else if (name == "CPUAffinity") {
+            CPUAffinity = opt.spin_value();
+
+            sworker.affinity(CPUAffinity);
         }
         else if (name == "UciLog") {
             UciLog = opt.check_value();
@@ -341,16 +451,24 @@ void uci_stop()
     if (!Searching)
         return;
 
-    StopRequest = true;
+    search_stop();
 
-    sthread.join();
+    sworker.wait();
 
     Searching = false;
     StopRequest = false;
+    Pondering = false;
+
+    for (const string& line : opt_queue)
+        uci_setoption(line);
+
+    opt_queue.clear();
 }
 
 void uci_ucinewgame()
 {
+    cluster_forward("ucinewgame");
+
     search_reset();
 
     uci_position("position startpos");
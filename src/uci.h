@@ -48,12 +48,19 @@ void uci_setoption(const std::string& s);
 
 std::string uci_score(int score);
 
+extern bool IIR;
+extern int IIRDepthMin;
+
+extern int MultiPV;
+
 extern bool NMPruning;
 extern int NMPruningDepthMin;
 
 extern bool SingularExt;
 extern int SEDepthMin;
 extern int SEDepthOffset;
+extern bool SEMultiCut;
+extern bool SENegExt;
 
 extern bool StaticNMP;
 extern int StaticNMPDepthMax;
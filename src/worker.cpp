@@ -0,0 +1,100 @@
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "worker.h"
+using namespace std;
+
+Worker::~Worker()
+{
+    if (!thread_.joinable())
+        return;
+
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        exit_ = true;
+    }
+
+    cond_.notify_all();
+    thread_.join();
+}
+
+void Worker::init()
+{
+    if (!thread_.joinable())
+        thread_ = thread(&Worker::loop, this);
+}
+
+// A negative cpu leaves scheduling to the OS
+void Worker::affinity([[maybe_unused]] int cpu)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        for (int i = 0; i < CPU_SETSIZE; i++)
+            CPU_SET(i, &set);
+    }
+    else
+        CPU_SET(cpu, &set);
+
+    pthread_setaffinity_np(thread_.native_handle(), sizeof(set), &set);
+#endif
+}
+
+void Worker::run(function<void()> job)
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        job_  = job;
+        busy_ = true;
+    }
+
+    cond_.notify_all();
+}
+
+void Worker::wait()
+{
+    unique_lock<mutex> lock(mutex_);
+
+    cond_.wait(lock, [this] { return !busy_; });
+}
+
+bool Worker::busy()
+{
+    lock_guard<mutex> lock(mutex_);
+
+    return busy_;
+}
+
+void Worker::loop()
+{
+    unique_lock<mutex> lock(mutex_);
+
+    while (true) {
+        cond_.wait(lock, [this] { return busy_ || exit_; });
+
+        if (exit_)
+            break;
+
+        lock.unlock();
+
+        job_();
+
+        lock.lock();
+
+        busy_ = false;
+
+        cond_.notify_all();
+    }
+}
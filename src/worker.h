@@ -0,0 +1,36 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// A long-lived thread that parks on a condition variable between jobs
+
+class Worker {
+public:
+    ~Worker();
+
+    void init();
+    void affinity(int cpu);
+
+    void run(std::function<void()> job);
+    void wait();
+
+    bool busy();
+
+private:
+    void loop();
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+
+    std::function<void()> job_;
+
+    bool busy_ = false;
+    bool exit_ = false;
+};
+
+#endif
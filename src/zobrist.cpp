@@ -1,6 +1,10 @@
 #include <iomanip>
+#include <utility>
 #include <vector>
+#include <cassert>
 #include <cstdint>
+#include "attacks.h"
+#include "bb.h"
 #include "piece.h"
 #include "pos.h"
 #include "square.h"
@@ -227,6 +231,74 @@ static constexpr int ZobristSideIndex   = 780;
 
 static u64 ZobristCastleFast[16];
 
+// Marcel van Kervinck's cuckoo tables of reversible moves, keyed by the
+// difference between the keys of the positions before and after the move
+
+static constexpr int CuckooSize = 8192;
+
+static u64 CuckooKeys[CuckooSize];
+static u16 CuckooSquares[CuckooSize];
+
+static constexpr int cuckoo_h1(u64 key) { return  key        & (CuckooSize - 1); }
+static constexpr int cuckoo_h2(u64 key) { return (key >> 16) & (CuckooSize - 1); }
+
+static void cuckoo_init()
+{
+    [[maybe_unused]]
+    int count = 0;
+
+    for (int pt12 = WN12; pt12 <= BK12; pt12++) {
+        Piece pt = Piece(pt12 / 2);
+
+        for (int sq1 = 0; sq1 < 64; sq1++) {
+            u64 att = pt == Knight ? KnightAttacks[sq1]
+                    : pt == Bishop ? BishopAttacks[sq1]
+                    : pt == Rook   ? RookAttacks[sq1]
+                    : pt == Queen  ? QueenAttacks[sq1]
+                    :                KingAttacks[sq1];
+
+            for (int sq2 = sq1 + 1; sq2 < 64; sq2++) {
+                if (!bb::test(att, sq2)) continue;
+
+                u64 key = piece(pt12, sq1) ^ piece(pt12, sq2) ^ side();
+                u16 sqs = sq1 | (sq2 << 6);
+
+                // Displace entries until an empty slot is found
+
+                for (int i = cuckoo_h1(key); ; ) {
+                    swap(CuckooKeys[i], key);
+                    swap(CuckooSquares[i], sqs);
+
+                    if (key == 0) break;
+
+                    i = i == cuckoo_h1(key) ? cuckoo_h2(key) : cuckoo_h1(key);
+                }
+
+                count++;
+            }
+        }
+    }
+
+    assert(count == 3668);
+}
+
+bool cuckoo(u64 key, int& sq1, int& sq2)
+{
+    int i = cuckoo_h1(key);
+
+    if (CuckooKeys[i] != key) {
+        i = cuckoo_h2(key);
+
+        if (CuckooKeys[i] != key)
+            return false;
+    }
+
+    sq1 = CuckooSquares[i] & 0x3f;
+    sq2 = CuckooSquares[i] >> 6;
+
+    return true;
+}
+
 void init()
 {
     for (int flags = 0; flags < 16; flags++) {
@@ -241,6 +313,8 @@ void init()
 
         ZobristCastleFast[flags] = zobrist;
     }
+
+    cuckoo_init();
 }
 
 u64 piece(int piece, int sq)
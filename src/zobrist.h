@@ -13,6 +13,8 @@ u64 castle(u8 flags);
 u64 ep(int sq);
 u64 side();
 
+bool cuckoo(u64 key, int& sq1, int& sq2);
+
 }
 
 #endif